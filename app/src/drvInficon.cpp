@@ -12,6 +12,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <errno.h>
+
+/* POSIX includes for the spectrum stream */
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 /* EPICS includes */
 #include <dbAccess.h>
@@ -35,13 +50,32 @@
 
 #include "drvInficon.h"
 
+#include <algorithm>
+
 /* Json parser includes */
 #include <json.hpp>
 using nlohmann::json;
 
 static const char *driverName = "INFICON";
 
+/* hardwareErrors and hardwareWarnings share the bit assignment */
+static const char *hwFaultNames[32] = {
+    "Reserved", "Reserved", "Reserved", "Reserved", "Reserved", "Reserved", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Reserved", "DEC control excursion", "Cathode/EE potential",
+    "Focus potential", "Filament current", "Filament potential",
+    "Peakfind", "DEC communications", "DSP communications", "DDS", "Detector", "Ion source",
+    "Mass filter", "Database", "Electrometer", "Electronics box temperature",
+    "Internal power supply", "Total pressure", "RF board", "Anode", "Electron multiplier",
+    "Emission"
+};
+
 static void pollerThreadC(void *drvPvt);
+static void pressureThreadC(void *drvPvt);
+static void captureThreadC(void *drvPvt);
+static void streamThreadC(void *drvPvt);
+static void bulkThreadC(void *drvPvt);
+static void publishThreadC(void *drvPvt);
+static bool parseStreamEndpoint(const char *endpoint, struct sockaddr_storage *addr, socklen_t *addrLen);
 
 //==========================================================//
 // class drvInficon
@@ -64,13 +98,17 @@ drvInficon::drvInficon(const char *portName, const char* hostInfo)
     isConnected_(false),
     portName_(epicsStrDup(portName)),
     octetPortName_(NULL),
+    bulkPortName_(NULL),
+    pressPortName_(NULL),
     hostInfo_(epicsStrDup(hostInfo)),
     data_(NULL),
+    pressData_(NULL),
 	ioStatus_(asynSuccess),
     prevIOStatus_(asynSuccess),
     totalPressure_(0),
     pollTime_(DEFAULT_POLL_TIME),
     forceCallback_(true),
+    dirtyAddr_(0),
     mainState_(IDLE),
     startingLeakcheck_(false),
     startingMonitor_(false),
@@ -85,7 +123,7 @@ drvInficon::drvInficon(const char *portName, const char* hostInfo)
     createParam(INFICON_GET_COMM_PARAM_STRING,     asynParamOctet,          &getCommParam_);
     createParam(INFICON_IP_STRING,                 asynParamOctet,          &ip_);
     createParam(INFICON_MAC_STRING,                asynParamOctet,          &mac_);
-    //createParam(INFICON_ERROR_LOG_STRING,          asynParamOctet,          &errorLog_);
+    createParam(INFICON_ERROR_LOG_STRING,          asynParamOctet,          &errorLog_);
     //General control parameters
     createParam(INFICON_EMI_ON_STRING,             asynParamUInt32Digital,  &emiOn_);
     createParam(INFICON_EM_ON_STRING,              asynParamUInt32Digital,  &emOn_);
@@ -172,6 +210,211 @@ drvInficon::drvInficon(const char *portName, const char* hostInfo)
     createParam(DRIVER_STATE_STRING,               asynParamUInt32Digital,  &driverState_);   
     createParam(MONITOR_START_STRING,              asynParamUInt32Digital,  &startMonitor_);
     createParam(LEAKCHECK_START_STRING,            asynParamUInt32Digital,  &startLeakcheck_);
+    //Total pressure history
+    createSetting(PRESS_POLL_TIME_STRING,          asynParamFloat64,        &pressPollTime_);
+    createSetting(PRESS_HIST_WINDOW_STRING,        asynParamFloat64,        &pressHistWindow_);
+    createSetting(PRESS_STAT_WINDOW_STRING,        asynParamFloat64,        &pressStatWindow_);
+    createParam(PRESS_HIST_STRING,                 asynParamFloat32Array,   &pressHist_);
+    createParam(PRESS_HIST_TIME_STRING,            asynParamFloat32Array,   &pressHistTime_);
+    createParam(PRESS_MIN_STRING,                  asynParamFloat64,        &pressMin_);
+    createParam(PRESS_MAX_STRING,                  asynParamFloat64,        &pressMax_);
+    createParam(PRESS_MEAN_STRING,                 asynParamFloat64,        &pressMean_);
+    //Event capture
+    createSetting(CAPTURE_ARM_STRING,              asynParamUInt32Digital,  &captureArm_);
+    createParam(CAPTURE_TRIG_STRING,               asynParamUInt32Digital,  &captureTrig_);
+    createSetting(CAPTURE_PRE_STRING,              asynParamInt32,          &capturePre_);
+    createSetting(CAPTURE_POST_STRING,             asynParamInt32,          &capturePost_);
+    createSetting(CAPTURE_PRESS_LEVEL_STRING,      asynParamFloat64,        &capturePressLevel_);
+    createSetting(CAPTURE_PRESS_RATE_STRING,       asynParamFloat64,        &capturePressRate_);
+    createSetting(CAPTURE_DIR_STRING,              asynParamOctet,          &captureDir_);
+    createParam(CAPTURE_STATE_STRING,              asynParamUInt32Digital,  &captureState_);
+    createParam(CAPTURE_BUSY_STRING,               asynParamUInt32Digital,  &captureBusy_);
+    createParam(CAPTURE_COUNT_STRING,              asynParamInt32,          &captureCount_);
+    createParam(CAPTURE_MISSED_STRING,             asynParamInt32,          &captureMissed_);
+    createParam(CAPTURE_FILE_STRING,               asynParamOctet,          &captureFile_);
+    //Gated acquisition
+    createSetting(GATE_STRING,                     asynParamInt32,          &gate_);
+    createSetting(GATE_MODE_STRING,                asynParamInt32,          &gateMode_);
+    createParam(GATE_RESET_STRING,                 asynParamUInt32Digital,  &gateReset_);
+    createParam(GATE_TAG_STRING,                   asynParamInt32,          &gateTag_);
+    createParam(GATE_COUNT_STRING,                 asynParamInt32,          &gateCount_);
+    createParam(GATE_AVG_STRING,                   asynParamFloat32Array,   &gateAvg_);
+    createParam(GATE_XCOORD_STRING,                asynParamFloat32Array,   &gateXCoord_);
+    //Sequence engine
+    createSetting(SEQ_FILE_STRING,                 asynParamOctet,          &seqFile_);
+    createParam(SEQ_START_STRING,                  asynParamUInt32Digital,  &seqStart_);
+    createParam(SEQ_STEPS_STRING,                  asynParamInt32,          &seqSteps_);
+    createParam(SEQ_STEP_STRING,                   asynParamInt32,          &seqStep_);
+    createParam(SEQ_STEP_NAME_STRING,              asynParamOctet,          &seqStepName_);
+    createParam(SEQ_CYCLE_STRING,                  asynParamInt32,          &seqCycle_);
+    createParam(SCAN_STEP_STRING,                  asynParamInt32,          &scanStep_);
+    createParam(SCAN_STEP_NAME_STRING,             asynParamOctet,          &scanStepName_);
+    //Spectrum statistics
+    createSetting(STATS_THRESHOLD_STRING,          asynParamFloat64,        &statsThreshold_);
+    createParam(STATS_SUM_STRING,                  asynParamFloat64,        &statsSum_);
+    createParam(STATS_MEAN_STRING,                 asynParamFloat64,        &statsMean_);
+    createParam(STATS_MAX_STRING,                  asynParamFloat64,        &statsMax_);
+    createParam(STATS_MAX_MASS_STRING,             asynParamFloat64,        &statsMaxMass_);
+    createParam(STATS_NOISE_STRING,                asynParamFloat64,        &statsNoise_);
+    createParam(STATS_ABOVE_STRING,                asynParamInt32,          &statsAbove_);
+    createParam(STATS_DYN_RANGE_STRING,            asynParamFloat64,        &statsDynRange_);
+    //Spectrum decimation
+    createSetting(DECIM_WIDTH_STRING,              asynParamInt32,          &decimWidth_);
+    createParam(DECIM_SCAN_STRING,                 asynParamFloat32Array,   &decimScan_);
+    createParam(DECIM_XCOORD_STRING,               asynParamFloat32Array,   &decimXCoord_);
+    //Regions of interest
+    createSetting(ROI_START_STRING,                asynParamFloat64,        &roiStart_);
+    createSetting(ROI_STOP_STRING,                 asynParamFloat64,        &roiStop_);
+    createSetting(ROI_DIVIDER_STRING,              asynParamInt32,          &roiDivider_);
+    createParam(ROI_POINTS_STRING,                 asynParamInt32,          &roiPoints_);
+    createParam(ROI_SCAN_STRING,                   asynParamFloat32Array,   &roiScan_);
+    createParam(ROI_XCOORD_STRING,                 asynParamFloat32Array,   &roiXCoord_);
+    //Unit conversion
+    createSetting(CONV_UNITS_STRING,               asynParamInt32,          &convUnits_);
+    createSetting(CONV_EGU_STRING,                 asynParamOctet,          &convEgu_);
+    createSetting(CONV_RSF_FILE_STRING,            asynParamOctet,          &convRsfFile_);
+    createParam(CONV_RSF_COUNT_STRING,             asynParamInt32,          &convRsfCount_);
+    createParam(CONV_SCAN_STRING,                  asynParamFloat32Array,   &convScan_);
+    //Mass axis calibration
+    createSetting(CAL_ENABLE_STRING,               asynParamUInt32Digital,  &calEnable_);
+    createSetting(CAL_ORDER_STRING,                asynParamInt32,          &calOrder_);
+    createSetting(CAL_THRESHOLD_STRING,            asynParamFloat64,        &calThreshold_);
+    createSetting(CAL_MIN_SNR_STRING,              asynParamFloat64,        &calMinSnr_);
+    createParam(CAL_C0_STRING,                     asynParamFloat64,        &calC0_);
+    createParam(CAL_C1_STRING,                     asynParamFloat64,        &calC1_);
+    createParam(CAL_C2_STRING,                     asynParamFloat64,        &calC2_);
+    createParam(CAL_RESIDUAL_STRING,               asynParamFloat64,        &calResidual_);
+    createParam(CAL_DRIFT_STRING,                  asynParamFloat64,        &calDrift_);
+    createParam(CAL_PEAKS_STRING,                  asynParamInt32,          &calPeaks_);
+    createParam(CAL_FITS_STRING,                   asynParamInt32,          &calFits_);
+    //Peak shape analysis
+    createSetting(PEAK_DIVIDER_STRING,             asynParamInt32,          &peakDivider_);
+    createSetting(PEAK_NUM_STRING,                 asynParamInt32,          &peakNum_);
+    createSetting(PEAK_MIN_SNR_STRING,             asynParamFloat64,        &peakMinSnr_);
+    createParam(PEAK_FOUND_STRING,                 asynParamInt32,          &peakFound_);
+    createParam(PEAK_MASS_STRING,                  asynParamFloat32Array,   &peakMass_);
+    createParam(PEAK_FWHM_STRING,                  asynParamFloat32Array,   &peakFwhm_);
+    createParam(PEAK_ASYM_STRING,                  asynParamFloat32Array,   &peakAsym_);
+    createParam(PEAK_RES_STRING,                   asynParamFloat32Array,   &peakRes_);
+    createParam(PEAK_FWHM_MEAN_STRING,             asynParamFloat64,        &peakFwhmMean_);
+    createParam(PEAK_RES_MEAN_STRING,              asynParamFloat64,        &peakResMean_);
+    createParam(PEAK_TREND_FWHM_STRING,            asynParamFloat32Array,   &peakTrendFwhm_);
+    createParam(PEAK_TREND_RES_STRING,             asynParamFloat32Array,   &peakTrendRes_);
+    //Anomaly detection
+    createSetting(ANOM_ENABLE_STRING,              asynParamUInt32Digital,  &anomEnable_);
+    createParam(ANOM_RESET_STRING,                 asynParamUInt32Digital,  &anomReset_);
+    createSetting(ANOM_ALPHA_STRING,               asynParamFloat64,        &anomAlpha_);
+    createSetting(ANOM_THRESHOLD_STRING,           asynParamFloat64,        &anomThreshold_);
+    createSetting(ANOM_WARMUP_STRING,              asynParamInt32,          &anomWarmup_);
+    createSetting(ANOM_RELEARN_STRING,             asynParamInt32,          &anomRelearn_);
+    createParam(ANOM_SCORE_STRING,                 asynParamFloat64,        &anomScore_);
+    createParam(ANOM_ALARM_STRING,                 asynParamInt32,          &anomAlarm_);
+    createParam(ANOM_COUNT_STRING,                 asynParamInt32,          &anomCount_);
+    createParam(ANOM_TOP_MASS_STRING,              asynParamFloat32Array,   &anomTopMass_);
+    createParam(ANOM_TOP_SCORE_STRING,             asynParamFloat32Array,   &anomTopScore_);
+    createParam(ANOM_REF_STRING,                   asynParamFloat32Array,   &anomRef_);
+    //Mass ratios
+    createParam(MASS_INTEGRAL_STRING,              asynParamFloat32Array,   &massIntegral_);
+    createParam(MASS_INTEGRAL_MASS_STRING,         asynParamFloat32Array,   &massIntegralMass_);
+    createSetting(RATIO_WIDTH_STRING,              asynParamFloat64,        &ratioWidth_);
+    createSetting(RATIO_WINDOW_STRING,             asynParamInt32,          &ratioWindow_);
+    createSetting(RATIO_NUM_STRING,                asynParamInt32,          &ratioNum_);
+    createSetting(RATIO_DEN_STRING,                asynParamInt32,          &ratioDen_);
+    createSetting(RATIO_NUM_WIDTH_STRING,          asynParamFloat64,        &ratioNumWidth_);
+    createSetting(RATIO_DEN_WIDTH_STRING,          asynParamFloat64,        &ratioDenWidth_);
+    createParam(RATIO_VALUE_STRING,                asynParamFloat64,        &ratioValue_);
+    createParam(RATIO_MEAN_STRING,                 asynParamFloat64,        &ratioMean_);
+    createParam(RATIO_STD_STRING,                  asynParamFloat64,        &ratioStd_);
+    createSetting(AIR_RATIO_STRING,                asynParamInt32,          &airRatio_);
+    createSetting(AIR_LOW_STRING,                  asynParamFloat64,        &airLow_);
+    createSetting(AIR_HIGH_STRING,                 asynParamFloat64,        &airHigh_);
+    createParam(AIR_LEAK_STRING,                   asynParamInt32,          &airLeak_);
+    createSetting(WATER_RATIO_STRING,              asynParamInt32,          &waterRatio_);
+    createSetting(WATER_ON_STRING,                 asynParamFloat64,        &waterOn_);
+    createSetting(WATER_OFF_STRING,                asynParamFloat64,        &waterOff_);
+    createParam(WATER_DOMINATED_STRING,            asynParamInt32,          &waterDominated_);
+    //Partial vs total pressure consistency
+    createParam(CONS_RATIO_STRING,                 asynParamFloat64,        &consRatio_);
+    createParam(CONS_DRIFT_STRING,                 asynParamFloat64,        &consDrift_);
+    createSetting(CONS_DRIFT_LIMIT_STRING,         asynParamFloat64,        &consDriftLimit_);
+    createParam(CONS_ALARM_STRING,                 asynParamInt32,          &consAlarm_);
+    createParam(CONS_TREND_STRING,                 asynParamFloat32Array,   &consTrend_);
+    createParam(CONS_RESET_STRING,                 asynParamUInt32Digital,  &consReset_);
+    //EM gain calibration
+    createParam(EMCAL_START_STRING,                asynParamUInt32Digital,  &emCalStart_);
+    createSetting(EMCAL_TARGET_STRING,             asynParamFloat64,        &emCalTarget_);
+    createSetting(EMCAL_TOLERANCE_STRING,          asynParamFloat64,        &emCalTolerance_);
+    createSetting(EMCAL_SCANS_STRING,              asynParamInt32,          &emCalScans_);
+    createParam(EMCAL_PHASE_STRING,                asynParamInt32,          &emCalPhase_);
+    createParam(EMCAL_ITER_STRING,                 asynParamInt32,          &emCalIter_);
+    createParam(EMCAL_VOLTAGE_STRING,              asynParamInt32,          &emCalVoltage_);
+    createParam(EMCAL_GAIN_STRING,                 asynParamFloat64,        &emCalGain_);
+    createParam(EMCAL_FARADAY_STRING,              asynParamFloat64,        &emCalFaraday_);
+    //Lifetime analytics
+    createSetting(LIFE_FILE_STRING,                asynParamOctet,          &lifeFile_);
+    createSetting(LIFE_PERIOD_STRING,              asynParamInt32,          &lifePeriod_);
+    createSetting(LIFE_FIL_LIMIT_STRING,           asynParamFloat64,        &lifeFilLimit_);
+    createParam(LIFE_SAMPLES_STRING,               asynParamInt32,          &lifeSamples_);
+    createParam(LIFE_FIL_RATE_STRING,              asynParamFloat64,        &lifeFilRate_);
+    createParam(LIFE_FIL_REMAIN_STRING,            asynParamFloat64,        &lifeFilRemain_);
+    createParam(LIFE_EM_RATE_STRING,               asynParamFloat64,        &lifeEmRate_);
+    createParam(LIFE_EM_REMAIN_STRING,             asynParamFloat64,        &lifeEmRemain_);
+    //Diagnostic trends
+    createSetting(TREND_PERIOD_STRING,             asynParamFloat64,        &trendPeriod_);
+    createSetting(TREND_CHANNEL_STRING,            asynParamInt32,          &trendChannel_);
+    createSetting(TREND_BUCKET_STRING,             asynParamFloat64,        &trendBucket_);
+    createParam(TREND_RESET_STRING,                asynParamUInt32Digital,  &trendReset_);
+    createParam(TREND_POINTS_STRING,               asynParamInt32,          &trendPoints_);
+    createParam(TREND_TIME_STRING,                 asynParamFloat32Array,   &trendTime_);
+    createParam(TREND_MIN_STRING,                  asynParamFloat32Array,   &trendMin_);
+    createParam(TREND_MAX_STRING,                  asynParamFloat32Array,   &trendMax_);
+    createParam(TREND_MEAN_STRING,                 asynParamFloat32Array,   &trendMean_);
+    //Fault event log
+    createParam(FAULT_LOG_STRING,                  asynParamOctet,          &faultLog_);
+    createParam(FAULT_ACTIVE_STRING,               asynParamOctet,          &faultActive_);
+    createParam(FAULT_ACTIVE_COUNT_STRING,         asynParamInt32,          &faultActiveCount_);
+    createParam(FAULT_EVENT_COUNT_STRING,          asynParamInt32,          &faultEventCount_);
+    //Spectrum streaming
+    createSetting(STREAM_ENDPOINT_STRING,          asynParamOctet,          &streamEndpoint_);
+    createSetting(STREAM_QUEUE_STRING,             asynParamInt32,          &streamQueue_);
+    createParam(STREAM_LISTENING_STRING,           asynParamInt32,          &streamListening_);
+    createParam(STREAM_CLIENTS_STRING,             asynParamInt32,          &streamClients_);
+    createParam(STREAM_FRAMES_STRING,              asynParamInt32,          &streamFrames_);
+    createParam(STREAM_DROPS_STRING,               asynParamInt32,          &streamDrops_);
+    //Shared memory export
+    createSetting(SHM_ENABLE_STRING,               asynParamUInt32Digital,  &shmEnable_);
+    createParam(SHM_NAME_STRING,                   asynParamOctet,          &shmName_);
+    createParam(SHM_WRITES_STRING,                 asynParamInt32,          &shmWrites_);
+    //Published spectrum identity
+    createParam(SCAN_NUMBER_STRING,                asynParamInt32,          &scanNumber_);
+    createParam(SCAN_CHANNEL_STRING,               asynParamInt32,          &scanChannel_);
+    createParam(SCAN_GATE_STRING,                  asynParamInt32,          &scanGate_);
+    createParam(MASS_AXIS_VERSION_STRING,          asynParamInt32,          &massAxisVersion_);
+    //Control and bulk connections
+    createParam(LANE_REQUESTS_STRING,              asynParamInt32,          &laneRequests_);
+    createParam(LANE_ERRORS_STRING,                asynParamInt32,          &laneErrors_);
+    createParam(LANE_LATENCY_STRING,               asynParamFloat64,        &laneLatency_);
+    createParam(LANE_LATENCY_MAX_STRING,           asynParamFloat64,        &laneLatencyMax_);
+    createParam(LANE_LATENCY_MEAN_STRING,          asynParamFloat64,        &laneLatencyMean_);
+    createParam(LANE_KBYTES_STRING,                asynParamFloat64,        &laneKBytes_);
+    //Scan completion prediction
+    createSetting(SCAN_ALIGN_STRING,               asynParamUInt32Digital,  &scanAlign_);
+    createParam(SCAN_PERIOD_EST_STRING,            asynParamFloat64,        &scanPeriodEst_);
+    createParam(SCAN_PREDICT_ERROR_STRING,         asynParamFloat64,        &scanPredictError_);
+    createParam(SCAN_IDLE_POLLS_STRING,            asynParamInt32,          &scanIdlePolls_);
+    //Poll clock
+    createSetting(POLL_PERIOD_STRING,              asynParamFloat64,        &pollPeriod_);
+    createParam(POLL_CYCLE_STRING,                 asynParamFloat64,        &pollCycle_);
+    createParam(POLL_CYCLE_MAX_STRING,             asynParamFloat64,        &pollCycleMax_);
+    createParam(POLL_OVERRUNS_STRING,              asynParamInt32,          &pollOverruns_);
+    createParam(POLL_SKIPPED_STRING,               asynParamInt32,          &pollSkipped_);
+    createParam(POLL_HIST_STRING,                  asynParamFloat32Array,   &pollHist_);
+    createParam(POLL_RESET_STRING,                 asynParamUInt32Digital,  &pollReset_);
+    //Publish thread
+    createParam(PUBLISH_SCANS_STRING,              asynParamInt32,          &publishScans_);
+    createParam(PUBLISH_COALESCED_STRING,          asynParamInt32,          &publishCoalesced_);
+    createParam(PUBLISH_TIME_STRING,               asynParamFloat64,        &publishTime_);
+    createParam(PUBLISH_TIME_MAX_STRING,           asynParamFloat64,        &publishTimeMax_);
 
     /* Create octet port name */
 	size_t prefixlen = strlen(PORT_PREFIX);
@@ -191,20 +434,413 @@ drvInficon::drvInficon(const char *portName, const char* hostInfo)
         return;
 	}
 
+    /* Spectra are read on a second connection so they never queue ahead of status requests */
+    bulkPortName_ = (char*)malloc(strlen(octetPortName_) + strlen(BULK_PORT_SUFFIX) + 1);
+    strcpy(bulkPortName_, octetPortName_);
+    strcat(bulkPortName_, BULK_PORT_SUFFIX);
+	ipConfigureStatus = drvAsynIPPortConfigure(bulkPortName_, hostInfo_, 0, 0, 0);
+
+	if (ipConfigureStatus) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s, Unable to configure drvAsynIPPort %s",
+            driverName, functionName, bulkPortName_);
+        return;
+	}
+
+    /* Total pressure has its own connection too, so a sample never waits behind the poller */
+    pressPortName_ = (char*)malloc(strlen(octetPortName_) + strlen(PRESS_PORT_SUFFIX) + 1);
+    strcpy(pressPortName_, octetPortName_);
+    strcat(pressPortName_, PRESS_PORT_SUFFIX);
+	ipConfigureStatus = drvAsynIPPortConfigure(pressPortName_, hostInfo_, 0, 0, 0);
+
+	if (ipConfigureStatus) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s, Unable to configure drvAsynIPPort %s",
+            driverName, functionName, pressPortName_);
+        return;
+	}
+
     /*Allocate memory*/
     data_ = (char*)callocMustSucceed(HTTP_RESPONSE_SIZE, sizeof(char), functionName);
+    pressData_ = (char*)callocMustSucceed(HTTP_RESPONSE_SIZE, sizeof(char), functionName);
 
     commParams_ = new commParamStruct;
     genCntrl_ = new genCntrlStruct;
     sensInfo_ = new sensInfoStruct;
     devStatus_ = new devStatusStruct;
     diagData_ = new diagDataStruct;
+    memset(diagData_, 0, sizeof(diagDataStruct));
     scanInfo_ = new scanInfoStruct;
     sensDetect_ = new sensDetectStruct;
     sensFilt_ = new sensFiltStruct;
     chScanSetup_ = new chScanSetupStruct[5];
     scanData_ = new scanDataStruct;
     sensIonSource_ = new sensIonSourceStruct;
+    pressHistory_ = new pressHistStruct;
+
+    /* Total pressure history defaults */
+    pressHistory_->pollTime = DEFAULT_PRESS_POLL_TIME;
+    pressHistory_->histWindow = DEFAULT_PRESS_HIST_WINDOW;
+    pressHistory_->statWindow = DEFAULT_PRESS_STAT_WINDOW;
+    pressHistory_->head = 0;
+    pressHistory_->count = 0;
+    setDoubleParam(pressPollTime_, pressHistory_->pollTime);
+    setDoubleParam(pressHistWindow_, pressHistory_->histWindow);
+    setDoubleParam(pressStatWindow_, pressHistory_->statWindow);
+
+    /* Event capture defaults */
+    capture_ = new captureStruct;
+    capture_->armed = false;
+    capture_->preScans = DEFAULT_CAPTURE_PRE;
+    capture_->postScans = DEFAULT_CAPTURE_POST;
+    capture_->pressLevel = 0;
+    capture_->pressRate = 0;
+    strcpy(capture_->directory, ".");
+    capture_->head = 0;
+    capture_->count = 0;
+    capture_->state = CAPTURE_DISARMED;
+    capture_->lastPressTime = 0;
+    capture_->lastPressValue = 0;
+    capture_->writerBusy = false;
+    capture_->captures = 0;
+    capture_->missed = 0;
+    capture_->lastFile[0] = '\0';
+    setUIntDigitalParam(captureArm_, 0, 0x1);
+    setIntegerParam(capturePre_, capture_->preScans);
+    setIntegerParam(capturePost_, capture_->postScans);
+    setDoubleParam(capturePressLevel_, capture_->pressLevel);
+    setDoubleParam(capturePressRate_, capture_->pressRate);
+    setStringParam(captureDir_, capture_->directory);
+    setUIntDigitalParam(captureState_, capture_->state, 0xF);
+    setUIntDigitalParam(captureBusy_, 0, 0x1);
+    setIntegerParam(captureCount_, 0);
+    setIntegerParam(captureMissed_, 0);
+    setStringParam(captureFile_, "");
+
+    /* Gated acquisition defaults */
+    gates_ = new gateStruct;
+    gates_->mode = GATE_OFF;
+    gates_->current = 0;
+    gates_->head = 0;
+    gates_->count = 0;
+    gates_->lastScanTime = 0;
+    resetGates();
+    setIntegerParam(gate_, 0);
+    setIntegerParam(gateMode_, gates_->mode);
+    setIntegerParam(gateTag_, 0);
+
+    /* Sequence engine defaults, no recipe loaded */
+    sequence_ = new seqStruct;
+    sequence_->loaded = false;
+    sequence_->numSteps = 0;
+    setStringParam(seqFile_, "");
+    setIntegerParam(seqSteps_, 0);
+    setIntegerParam(seqStep_, 0);
+    setStringParam(seqStepName_, "");
+    setIntegerParam(seqCycle_, 0);
+    setIntegerParam(scanStep_, -1);
+    setStringParam(scanStepName_, "");
+
+    /* Spectrum statistics defaults */
+    scanStats_ = new scanStatsStruct;
+    scanStats_->threshold = 0;
+    scanStats_->noise = 0;
+    setDoubleParam(statsThreshold_, scanStats_->threshold);
+
+    /* Decimated spectrum defaults */
+    decim_ = new decimStruct;
+    decim_->width = DEFAULT_DECIM_SIZE;
+    decim_->size = 0;
+    setIntegerParam(decimWidth_, decim_->width);
+
+    /* Regions of interest defaults, all disabled */
+    for (int i = 0; i <= MAX_ROIS; i++) {
+        rois_[i].startMass = 0;
+        rois_[i].stopMass = 0;
+        rois_[i].divider = 1;
+        rois_[i].counter = 0;
+        rois_[i].first = 0;
+        rois_[i].size = 0;
+        setDoubleParam(i, roiStart_, 0);
+        setDoubleParam(i, roiStop_, 0);
+        setIntegerParam(i, roiDivider_, 1);
+        setIntegerParam(i, roiPoints_, 0);
+    }
+
+    /* Unit conversion defaults, Torr and the N2 sensitivity for every mass */
+    conv_ = new convStruct;
+    conv_->units = UNITS_TORR;
+    for (int i = 0; i <= CONV_MAX_MASS; i++)
+        conv_->rsf[i] = 1.0;
+    conv_->rsfCount = 0;
+    conv_->scaleValid = false;
+    conv_->size = 0;
+    //no conversion until the poller has read the sensitivity
+    sensIonSource_->ppSensFactor = 0;
+    setIntegerParam(convUnits_, conv_->units);
+    setStringParam(convEgu_, "Torr");
+    setStringParam(convRsfFile_, "");
+    setIntegerParam(convRsfCount_, 0);
+
+    /* Mass calibration defaults, H2, H2O, N2, Ar and CO2 as references */
+    static const double calRefMasses[] = {2, 18, 28, 40, 44};
+    cal_ = new calStruct;
+    cal_->enable = false;
+    cal_->order = 1;
+    cal_->threshold = DEFAULT_CAL_THRESHOLD;
+    cal_->minSnr = DEFAULT_CAL_MIN_SNR;
+    cal_->numRefs = sizeof(calRefMasses)/sizeof(calRefMasses[0]);
+    for (unsigned int i = 0; i < cal_->numRefs; i++)
+        cal_->refMass[i] = calRefMasses[i];
+    cal_->fits = 0;
+    resetMassCal();
+    setUIntDigitalParam(calEnable_, 0, 0x1);
+    setIntegerParam(calOrder_, cal_->order);
+    setDoubleParam(calThreshold_, cal_->threshold);
+    setDoubleParam(calMinSnr_, cal_->minSnr);
+    setDoubleParam(calDrift_, 0);
+    setIntegerParam(calPeaks_, 0);
+    setIntegerParam(calFits_, 0);
+
+    /* Peak shape analysis defaults, off until a divider is set */
+    peaks_ = new peakStruct;
+    peaks_->divider = 0;
+    peaks_->counter = 0;
+    peaks_->numPeaks = DEFAULT_PEAK_NUM;
+    peaks_->minSnr = DEFAULT_PEAK_MIN_SNR;
+    peaks_->found = 0;
+    peaks_->head = 0;
+    peaks_->count = 0;
+    setIntegerParam(peakDivider_, peaks_->divider);
+    setIntegerParam(peakNum_, peaks_->numPeaks);
+    setDoubleParam(peakMinSnr_, peaks_->minSnr);
+    setIntegerParam(peakFound_, 0);
+    setDoubleParam(peakFwhmMean_, 0);
+    setDoubleParam(peakResMean_, 0);
+
+    /* Anomaly detection defaults */
+    anomaly_ = new anomStruct;
+    anomaly_->enable = false;
+    anomaly_->alpha = DEFAULT_ANOM_ALPHA;
+    anomaly_->threshold = DEFAULT_ANOM_THRESHOLD;
+    anomaly_->warmup = DEFAULT_ANOM_WARMUP;
+    anomaly_->relearn = DEFAULT_ANOM_RELEARN;
+    anomaly_->count = 0;
+    anomaly_->alarmed = 0;
+    setUIntDigitalParam(anomEnable_, 0, 0x1);
+    setDoubleParam(anomAlpha_, anomaly_->alpha);
+    setDoubleParam(anomThreshold_, anomaly_->threshold);
+    setIntegerParam(anomWarmup_, anomaly_->warmup);
+    setIntegerParam(anomRelearn_, anomaly_->relearn);
+    setDoubleParam(anomScore_, 0);
+    setIntegerParam(anomAlarm_, 0);
+    setIntegerParam(anomCount_, 0);
+
+    /* Mass ratio defaults, N2/O2, Ar/N2, H2O/OH and H2O/N2, air watches 1 and water 3 */
+    static const int ratioMasses[RATIO_MAX + 1][2] = {{28, 28}, {28, 32}, {40, 28}, {18, 17}, {18, 28}};
+    ratios_ = new ratioStruct;
+    ratios_->width = DEFAULT_RATIO_WIDTH;
+    ratios_->window = DEFAULT_RATIO_WINDOW;
+    for (int i = 0; i <= CONV_MAX_MASS; i++)
+        ratios_->mass[i] = (float)i;
+    ratios_->airEntry = DEFAULT_AIR_RATIO;
+    ratios_->airLow = DEFAULT_AIR_LOW;
+    ratios_->airHigh = DEFAULT_AIR_HIGH;
+    ratios_->waterEntry = DEFAULT_WATER_RATIO;
+    ratios_->waterOn = DEFAULT_WATER_ON;
+    ratios_->waterOff = DEFAULT_WATER_OFF;
+    ratios_->airLeak = 0;
+    ratios_->waterDominated = 0;
+    ratios_->maxMass = 0;
+    for (int i = 0; i <= RATIO_MAX; i++) {
+        ratios_->entry[i].numMass = ratioMasses[i][0];
+        ratios_->entry[i].denMass = ratioMasses[i][1];
+        ratios_->entry[i].numWidth = DEFAULT_RATIO_WIDTH;
+        ratios_->entry[i].denWidth = DEFAULT_RATIO_WIDTH;
+        ratios_->entry[i].numSum = 0;
+        ratios_->entry[i].denSum = 0;
+        ratios_->entry[i].head = 0;
+        ratios_->entry[i].count = 0;
+        setIntegerParam(i, ratioNum_, ratioMasses[i][0]);
+        setIntegerParam(i, ratioDen_, ratioMasses[i][1]);
+        setDoubleParam(i, ratioNumWidth_, DEFAULT_RATIO_WIDTH);
+        setDoubleParam(i, ratioDenWidth_, DEFAULT_RATIO_WIDTH);
+        setDoubleParam(i, ratioValue_, 0);
+        setDoubleParam(i, ratioMean_, 0);
+        setDoubleParam(i, ratioStd_, 0);
+    }
+    setDoubleParam(ratioWidth_, ratios_->width);
+    setIntegerParam(ratioWindow_, ratios_->window);
+    setIntegerParam(airRatio_, ratios_->airEntry);
+    setDoubleParam(airLow_, ratios_->airLow);
+    setDoubleParam(airHigh_, ratios_->airHigh);
+    setIntegerParam(waterRatio_, ratios_->waterEntry);
+    setDoubleParam(waterOn_, ratios_->waterOn);
+    setDoubleParam(waterOff_, ratios_->waterOff);
+    setIntegerParam(airLeak_, 0);
+    setIntegerParam(waterDominated_, 0);
+
+    /* Consistency check defaults */
+    consistency_ = new consStruct;
+    consistency_->driftLimit = DEFAULT_CONS_DRIFT_LIMIT;
+    consistency_->lastTime = 0;
+    consistency_->head = 0;
+    consistency_->count = 0;
+    setDoubleParam(consRatio_, 0);
+    setDoubleParam(consDrift_, 0);
+    setDoubleParam(consDriftLimit_, consistency_->driftLimit);
+    setIntegerParam(consAlarm_, 0);
+
+    /* EM gain calibration defaults */
+    emCal_ = new emCalStruct;
+    emCal_->target = DEFAULT_EMCAL_TARGET;
+    emCal_->tolerance = DEFAULT_EMCAL_TOLERANCE;
+    emCal_->scans = DEFAULT_EMCAL_SCANS;
+    emCal_->phase = EMCAL_IDLE;
+    //filled by the poller from the detector settings
+    sensDetect_->emVMin = 0;
+    sensDetect_->emVMax = 0;
+    sensDetect_->emGainMass = 0;
+    setDoubleParam(emCalTarget_, emCal_->target);
+    setDoubleParam(emCalTolerance_, emCal_->tolerance);
+    setIntegerParam(emCalScans_, emCal_->scans);
+    setIntegerParam(emCalPhase_, emCal_->phase);
+    setIntegerParam(emCalIter_, 0);
+    setIntegerParam(emCalVoltage_, 0);
+    setDoubleParam(emCalGain_, 0);
+    setDoubleParam(emCalFaraday_, 0);
+
+    /* Lifetime analytics defaults, no store until LIFE_FILE is set */
+    life_ = new lifeStruct;
+    life_->fileName[0] = '\0';
+    life_->period = DEFAULT_LIFE_PERIOD;
+    life_->filCurrentLimit = DEFAULT_LIFE_FIL_LIMIT;
+    life_->periodStart = 0;
+    life_->sumEmi = life_->sumFil = life_->sumTemp = 0;
+    life_->samples = 0;
+    life_->head = 0;
+    life_->count = 0;
+    memset(devStatus_, 0, sizeof(devStatusStruct));
+    setStringParam(lifeFile_, "");
+    setIntegerParam(lifePeriod_, life_->period);
+    setDoubleParam(lifeFilLimit_, life_->filCurrentLimit);
+    setIntegerParam(lifeSamples_, 0);
+    setDoubleParam(lifeFilRate_, 0);
+    setDoubleParam(lifeFilRemain_, -1);
+    setDoubleParam(lifeEmRate_, 0);
+    setDoubleParam(lifeEmRemain_, -1);
+
+    /* Diagnostic trend defaults, seconds/minutes/hours on addresses 1..3 */
+    trend_ = new trendStruct;
+    trend_->period = DEFAULT_TREND_PERIOD;
+    trend_->channel = TREND_BOX_TEMP;
+    trend_->scale[1].bucket = DEFAULT_TREND_BUCKET_1;
+    trend_->scale[2].bucket = DEFAULT_TREND_BUCKET_2;
+    trend_->scale[3].bucket = DEFAULT_TREND_BUCKET_3;
+    setDoubleParam(trendPeriod_, trend_->period);
+    setIntegerParam(trendChannel_, trend_->channel);
+    for (int i = 1; i <= TREND_SCALES; i++) {
+        resetTrend(i);
+        setDoubleParam(i, trendBucket_, trend_->scale[i].bucket);
+    }
+
+    /* Fault event log, empty until the first status read */
+    faults_ = new faultStruct;
+    faults_->valid = false;
+    faults_->head = 0;
+    faults_->count = 0;
+    faults_->total = 0;
+    faults_->errorLog[0] = '\0';
+    setStringParam(errorLog_, "");
+    setStringParam(faultLog_, "");
+    setStringParam(faultActive_, "");
+    setIntegerParam(faultActiveCount_, 0);
+    setIntegerParam(faultEventCount_, 0);
+
+    /* Spectrum stream, the server starts once STREAM_ENDPOINT is set */
+    stream_ = new streamStruct;
+    stream_->endpoint[0] = '\0';
+    stream_->reconfigure = false;
+    stream_->depth = DEFAULT_STREAM_QUEUE;
+    stream_->listenFd = -1;
+    stream_->unixPath[0] = '\0';
+    stream_->clients = 0;
+    stream_->frames = 0;
+    stream_->drops = 0;
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        stream_->client[i].fd = -1;
+        stream_->client[i].head = 0;
+        stream_->client[i].count = 0;
+        stream_->client[i].sent = 0;
+        stream_->client[i].drops = 0;
+    }
+    stream_->pool = NULL;
+    if (pipe(stream_->wakeFd) == 0) {
+        fcntl(stream_->wakeFd[0], F_SETFL, fcntl(stream_->wakeFd[0], F_GETFL) | O_NONBLOCK);
+        fcntl(stream_->wakeFd[1], F_SETFL, fcntl(stream_->wakeFd[1], F_GETFL) | O_NONBLOCK);
+    }
+    streamLock_ = epicsMutexCreate();
+    setStringParam(streamEndpoint_, "");
+    setIntegerParam(streamQueue_, stream_->depth);
+    setIntegerParam(streamListening_, 0);
+    setIntegerParam(streamClients_, 0);
+    setIntegerParam(streamFrames_, 0);
+    setIntegerParam(streamDrops_, 0);
+
+    /* Shared memory export, created when enabled */
+    shm_ = NULL;
+    shmPath_[0] = '\0';
+    setUIntDigitalParam(shmEnable_, 0, 0x1);
+    setStringParam(shmName_, "");
+    setIntegerParam(shmWrites_, 0);
+
+    /* Identity of the published spectrum */
+    scanMeta_ = new scanMetaStruct;
+    scanMeta_->scanSize = 0;
+    scanMeta_->firstMass = 0;
+    scanMeta_->lastMass = 0;
+    scanMeta_->calFits = 0;
+    scanMeta_->axisVersion = 0;
+    setIntegerParam(scanNumber_, 0);
+    setIntegerParam(scanChannel_, 0);
+    setIntegerParam(scanGate_, 0);
+    setIntegerParam(massAxisVersion_, 0);
+
+    /* Connection statistics and the spectrum hand-over to the bulk thread */
+    memset(laneStats_, 0, sizeof(laneStats_));
+    laneLock_ = epicsMutexCreate();
+    publishLaneStats();
+    bulk_ = new bulkStruct;
+    bulk_->busy = false;
+    bulk_->discard = false;
+    bulk_->channel = 3;
+    bulk_->data = (char*)callocMustSucceed(HTTP_RESPONSE_SIZE, sizeof(char), functionName);
+
+    scanPredict_ = new scanPredictStruct;
+    memset(scanPredict_, 0, sizeof(scanPredictStruct));
+    scanPredict_->enable = true;
+    scanPredict_->channel = -1;
+    setUIntDigitalParam(scanAlign_, 1, 0x1);
+    setDoubleParam(scanPeriodEst_, 0);
+    setDoubleParam(scanPredictError_, 0);
+    setIntegerParam(scanIdlePolls_, 0);
+
+    pollClock_ = new pollClockStruct;
+    memset(pollClock_, 0, sizeof(pollClockStruct));
+    pollClock_->restart = true;
+    setDoubleParam(pollPeriod_, pollTime_);
+    setDoubleParam(pollCycle_, 0);
+    setDoubleParam(pollCycleMax_, 0);
+    setIntegerParam(pollOverruns_, 0);
+    setIntegerParam(pollSkipped_, 0);
+
+    publish_ = new publishStruct;
+    memset(publish_, 0, sizeof(publishStruct));
+    publishLock_ = epicsMutexCreate();
+    setIntegerParam(publishScans_, 0);
+    setIntegerParam(publishCoalesced_, 0);
+    setDoubleParam(publishTime_, 0);
+    setDoubleParam(publishTimeMax_, 0);
 
     /* Connect to asyn octet port with asynOctetSyncIO */
     status = pasynOctetSyncIO->connect(octetPortName_, 0, &pasynUserOctet_, 0);
@@ -215,6 +851,22 @@ drvInficon::drvInficon(const char *portName, const char* hostInfo)
         return;
     }
 
+    status = pasynOctetSyncIO->connect(bulkPortName_, 0, &pasynUserBulk_, 0);
+    if (status != asynSuccess) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s port %s can't connect to asynOctet on Octet server %s.\n",
+            driverName, functionName, portName_, bulkPortName_);
+        return;
+    }
+
+    status = pasynOctetSyncIO->connect(pressPortName_, 0, &pasynUserPress_, 0);
+    if (status != asynSuccess) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s port %s can't connect to asynOctet on Octet server %s.\n",
+            driverName, functionName, portName_, pressPortName_);
+        return;
+    }
+
     /* Create the epicsEvent to wake up the pollerThread.*/
     pollerEventId_ = epicsEventCreate(epicsEventEmpty);
 
@@ -225,6 +877,49 @@ drvInficon::drvInficon(const char *portName, const char* hostInfo)
             (EPICSTHREADFUNC)pollerThreadC,
             this);
 
+    /* Create the epicsEvent and the thread sampling total pressure on its own schedule */
+    pressureEventId_ = epicsEventCreate(epicsEventEmpty);
+
+    pressureThreadId_ = epicsThreadCreate("InficonPress",
+            epicsThreadPriorityMedium,
+            epicsThreadGetStackSize(epicsThreadStackMedium),
+            (EPICSTHREADFUNC)pressureThreadC,
+            this);
+
+    /* Create the epicsEvent and the thread writing captured events to file */
+    captureEventId_ = epicsEventCreate(epicsEventEmpty);
+
+    captureThreadId_ = epicsThreadCreate("InficonCapture",
+            epicsThreadPriorityLow,
+            epicsThreadGetStackSize(epicsThreadStackMedium),
+            (EPICSTHREADFUNC)captureThreadC,
+            this);
+
+    /* Create the thread serving spectra to local stream clients */
+    streamThreadId_ = epicsThreadCreate("InficonStream",
+            epicsThreadPriorityLow,
+            epicsThreadGetStackSize(epicsThreadStackMedium),
+            (EPICSTHREADFUNC)streamThreadC,
+            this);
+
+    /* Create the epicsEvent and the thread reading spectra on the bulk connection */
+    bulkEventId_ = epicsEventCreate(epicsEventEmpty);
+
+    bulkThreadId_ = epicsThreadCreate("InficonBulk",
+            epicsThreadPriorityMedium,
+            epicsThreadGetStackSize(epicsThreadStackMedium),
+            (EPICSTHREADFUNC)bulkThreadC,
+            this);
+
+    /* Create the epicsEvent and the thread doing the callbacks for the poller and the bulk thread */
+    publishEventId_ = epicsEventCreate(epicsEventEmpty);
+
+    publishThreadId_ = epicsThreadCreate("InficonPublish",
+            epicsThreadPriorityLow,
+            epicsThreadGetStackSize(epicsThreadStackMedium),
+            (EPICSTHREADFUNC)publishThreadC,
+            this);
+
     //epicsAtExit(inficonExitCallback, this);
 
     initialized_ = true;
@@ -237,12 +932,24 @@ drvInficon::~drvInficon() {
 		free(portName_);
 	if (octetPortName_)
 		free(octetPortName_);
+	if (bulkPortName_)
+		free(bulkPortName_);
+	if (pressPortName_)
+		free(pressPortName_);
+	if (pressData_)
+		free(pressData_);
 	if (data_)
 		free(data_);
 	
 	pasynManager->disconnect(pasynUserOctet_);
     pasynManager->freeAsynUser(pasynUserOctet_);
     pasynUserOctet_ = NULL;
+	pasynManager->disconnect(pasynUserBulk_);
+    pasynManager->freeAsynUser(pasynUserBulk_);
+    pasynUserBulk_ = NULL;
+	pasynManager->disconnect(pasynUserPress_);
+    pasynManager->freeAsynUser(pasynUserPress_);
+    pasynUserPress_ = NULL;
 
     delete commParams_;
     delete genCntrl_;
@@ -255,6 +962,86 @@ drvInficon::~drvInficon() {
     delete chScanSetup_;
     delete scanData_;
     delete sensIonSource_;
+    delete pressHistory_;
+    delete capture_;
+    delete gates_;
+    delete sequence_;
+    delete scanStats_;
+    delete decim_;
+    delete conv_;
+    delete cal_;
+    delete peaks_;
+    delete anomaly_;
+    delete ratios_;
+    delete consistency_;
+    delete emCal_;
+    delete life_;
+    delete trend_;
+    delete faults_;
+    closeShm();
+    delete [] stream_->pool;
+    delete stream_;
+    delete scanMeta_;
+    free(bulk_->data);
+    delete bulk_;
+    delete scanPredict_;
+    delete pollClock_;
+    delete publish_;
+}
+
+/*******************************/
+/* Parameter library overrides */
+/*******************************/
+/* The single address forms of the base class end up here as list 0, the digital
+ * setters all forward to the five argument form. Only the address is recorded, the
+ * parameter list itself keeps track of which values changed, so callbacks can skip
+ * the addresses nothing was written to. */
+asynStatus drvInficon::setIntegerParam(int list, int index, int value)
+{
+    if (list >= 0 && list < MAX_CHANNELS)
+        dirtyAddr_ |= 1u << list;
+    return asynPortDriver::setIntegerParam(list, index, value);
+}
+
+asynStatus drvInficon::setDoubleParam(int list, int index, double value)
+{
+    if (list >= 0 && list < MAX_CHANNELS)
+        dirtyAddr_ |= 1u << list;
+    return asynPortDriver::setDoubleParam(list, index, value);
+}
+
+asynStatus drvInficon::setStringParam(int list, int index, const char *value)
+{
+    if (list >= 0 && list < MAX_CHANNELS)
+        dirtyAddr_ |= 1u << list;
+    return asynPortDriver::setStringParam(list, index, value);
+}
+
+asynStatus drvInficon::setUIntDigitalParam(int list, int index, epicsUInt32 value, epicsUInt32 valueMask,
+                                           epicsUInt32 interruptMask)
+{
+    if (list >= 0 && list < MAX_CHANNELS)
+        dirtyAddr_ |= 1u << list;
+    return asynPortDriver::setUIntDigitalParam(list, index, value, valueMask, interruptMask);
+}
+
+/* createParam for a driver setting. Settings are kept in the parameter library,
+ * the read methods report them back to the output records on init. */
+asynStatus drvInficon::createSetting(const char *name, asynParamType type, int *index)
+{
+    asynStatus status = createParam(name, type, index);
+
+    if (status == asynSuccess) {
+        if ((size_t)*index >= settings_.size())
+            settings_.resize(*index + 1, false);
+        settings_[*index] = true;
+    }
+    return status;
+}
+
+bool drvInficon::isSetting(int index) const
+{
+    return index >= 0 && (size_t)index < settings_.size() && settings_[index];
 }
 
 /***********************/
@@ -276,6 +1063,8 @@ void drvInficon::report(FILE *fp, int details)
     if (details) {
         fprintf(fp, "    initialized:        %s\n", initialized_ ? "true" : "false");
         fprintf(fp, "    asynOctet server:   %s\n", octetPortName_);
+        fprintf(fp, "    spectrum server:    %s\n", bulkPortName_);
+        fprintf(fp, "    pressure server:    %s\n", pressPortName_);
         fprintf(fp, "    host info:          %s\n", hostInfo_);
     }
     asynPortDriver::report(fp, details);
@@ -286,8 +1075,11 @@ void drvInficon::report(FILE *fp, int details)
 */
 asynStatus drvInficon::readUInt32Digital(asynUser *pasynUser, epicsUInt32 *value, epicsUInt32 mask)
 {
-    //int function = pasynUser->reason;
+    int function = pasynUser->reason;
     //static const char *functionName = "readUInt32D";
+
+    if (isSetting(function))
+        return asynPortDriver::readUInt32Digital(pasynUser, value, mask);
 	
     *value = 0;
 
@@ -397,6 +1189,10 @@ asynStatus drvInficon::writeUInt32Digital(asynUser *pasynUser, epicsUInt32 value
         if (ioStatus_ != asynSuccess)
             return(ioStatus_);
 
+        //a stopped calibration still has to give channel 4 back
+        if (mainState_ == EMCAL)
+            finishEmCal(EMCAL_ABORTED);
+
         //If we get up to here set the internal driver state
         mainState_ = IDLE;
         setUIntDigitalParam(driverState_, static_cast<unsigned int>(mainState_), 0xF);
@@ -455,6 +1251,108 @@ asynStatus drvInficon::writeUInt32Digital(asynUser *pasynUser, epicsUInt32 value
         setUIntDigitalParam(driverState_, static_cast<unsigned int>(mainState_), 0xF);
         //printf("%s::%s mainState:%d\n", driverName, functionName, static_cast<unsigned int>(mainState_));
 
+    } else if (function == captureArm_) {
+        capture_->armed = (value != 0);
+        if (!capture_->armed) {
+            capture_->state = CAPTURE_DISARMED;
+        } else if (capture_->state == CAPTURE_DISARMED) {
+            //start with an empty pre-trigger buffer
+            capture_->count = 0;
+            capture_->state = CAPTURE_ARMED;
+        }
+        setUIntDigitalParam(captureArm_, value, 0x1);
+        setUIntDigitalParam(captureState_, capture_->state, 0xF);
+
+    } else if (function == captureTrig_) {
+        if (value)
+            triggerCapture(CAPTURE_TRIG_EXTERNAL);
+
+    } else if (function == gateReset_) {
+        resetGates();
+
+    } else if (function == calEnable_) {
+        cal_->enable = (value != 0);
+        resetMassCal();
+        setUIntDigitalParam(calEnable_, value, 0x1);
+
+    } else if (function == anomEnable_) {
+        anomaly_->enable = (value != 0);
+        setUIntDigitalParam(anomEnable_, value, 0x1);
+
+    } else if (function == anomReset_) {
+        anomaly_->count = 0;
+        setIntegerParam(anomCount_, 0);
+        setIntegerParam(anomAlarm_, 0);
+
+    } else if (function == consReset_) {
+        //e.g. after an EM recalibration the ratio steps, start a new trend
+        consistency_->count = 0;
+        setDoubleParam(consDrift_, 0);
+        setIntegerParam(consAlarm_, 0);
+
+    } else if (function == shmEnable_) {
+        if (value) {
+            if (openShm() != asynSuccess)
+                return asynError;
+        } else {
+            closeShm();
+        }
+        setUIntDigitalParam(shmEnable_, value ? 1 : 0, 0x1);
+
+    } else if (function == scanAlign_) {
+        scanPredict_->enable = (value != 0);
+        setUIntDigitalParam(scanAlign_, value ? 1 : 0, 0x1);
+
+    } else if (function == pollReset_) {
+        pollClock_->maxCycle = 0;
+        pollClock_->overruns = 0;
+        pollClock_->skipped = 0;
+        memset(pollClock_->hist, 0, sizeof(pollClock_->hist));
+        publishPollClock();
+
+    } else if (function == trendReset_) {
+        for (int i = 1; i <= TREND_SCALES; i++)
+            resetTrend(i);
+        publishTrends(true);
+
+    } else if (function == emCalStart_) {
+        if (value == 0) {
+            if (mainState_ == EMCAL)
+                finishEmCal(EMCAL_ABORTED);
+        } else {
+            //check if we are in idle state
+            if (mainState_ != IDLE && scanInfo_->scanStatus != 0) {
+                asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                          "%s::%s device not in idle state\n",
+                          driverName, functionName);
+                return asynError;
+            }
+
+            if (startEmCal() != asynSuccess)
+                return asynError;
+
+            //If we get up to here set the internal driver state
+            mainState_ = EMCAL;
+            setUIntDigitalParam(driverState_, static_cast<unsigned int>(mainState_), 0xF);
+        }
+
+    } else if (function == seqStart_) {
+        //check if we are in idle state
+        if (mainState_ != IDLE && scanInfo_->scanStatus != 0) {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                      "%s::%s device not in idle state\n",
+                      driverName, functionName);
+            return asynError;
+		}
+
+        if (startSequence() != asynSuccess)
+            return asynError;
+
+        //If we get up to here set the internal driver state
+        mainState_ = SEQUENCE;
+        startingMonitor_ = true;
+        setUIntDigitalParam(driverState_, static_cast<unsigned int>(mainState_), 0xF);
+
     } else if (function == startLeakcheck_) {
         //check if we are in idle state
         if (mainState_ != IDLE && scanInfo_->scanStatus != 0) {
@@ -510,9 +1408,12 @@ asynStatus drvInficon::writeUInt32Digital(asynUser *pasynUser, epicsUInt32 value
 */
 asynStatus drvInficon::readInt32 (asynUser *pasynUser, epicsInt32 *value)
 {
-    //int function = pasynUser->reason;
+    int function = pasynUser->reason;
     //static const char *functionName = "readInt32";
 
+    if (isSetting(function))
+        return asynPortDriver::readInt32(pasynUser, value);
+
     *value = 0;
 
     return asynSuccess;
@@ -538,12 +1439,181 @@ asynStatus drvInficon::writeInt32(asynUser *pasynUser, epicsInt32 value)
         if (ioStatus_ != asynSuccess)
             return(ioStatus_);
 
+    } else if (function == capturePre_) {
+        if (value < 0 || value > CAPTURE_MAX_PRE)
+            return asynError;
+
+        capture_->preScans = value;
+        setIntegerParam(capturePre_, value);
+
+    } else if (function == capturePost_) {
+        if (value < 0 || value > CAPTURE_MAX_POST)
+            return asynError;
+
+        capture_->postScans = value;
+        setIntegerParam(capturePost_, value);
+
+    } else if (function == gate_) {
+        if (value < 0 || value > MAX_GATES)
+            return asynError;
+
+        //record the transition time, the poller matches it against scan windows
+        if (value != gates_->current) {
+            epicsTimeStamp now;
+            epicsTimeGetCurrent(&now);
+            gates_->histTime[gates_->head] = now.secPastEpoch + now.nsec * 1e-9;
+            gates_->histGate[gates_->head] = value;
+            gates_->head = (gates_->head + 1) % GATE_HIST_SIZE;
+            if (gates_->count < GATE_HIST_SIZE)
+                gates_->count++;
+            gates_->current = value;
+        }
+        setIntegerParam(gate_, value);
+
+    } else if (function == gateMode_) {
+        if (value < GATE_OFF || value > GATE_KEEP)
+            return asynError;
+
+        gates_->mode = static_cast<gateMode_t>(value);
+        setIntegerParam(gateMode_, value);
+
+    } else if (function == decimWidth_) {
+        if (value < MIN_DECIM_SIZE || value > MAX_DECIM_SIZE)
+            return asynError;
+
+        //two points per bucket
+        decim_->width = value & ~1;
+        setIntegerParam(decimWidth_, decim_->width);
+
+    } else if (function == roiDivider_) {
+        if (chNumber < 1 || chNumber > MAX_ROIS || value < 1)
+            return asynError;
+
+        rois_[chNumber].divider = value;
+        rois_[chNumber].counter = 0;
+        setIntegerParam(chNumber, roiDivider_, value);
+
+    } else if (function == convUnits_) {
+        static const char *unitNames[] = {"Torr", "mbar", "Pa"};
+
+        if (value < UNITS_TORR || value > UNITS_PA)
+            return asynError;
+
+        conv_->units = static_cast<convUnits_t>(value);
+        conv_->scaleValid = false;
+        setIntegerParam(convUnits_, value);
+        setStringParam(convEgu_, unitNames[value]);
+
+    } else if (function == calOrder_) {
+        if (value < 1 || value > 2)
+            return asynError;
+
+        cal_->order = value;
+        resetMassCal();
+        setIntegerParam(calOrder_, value);
+
+    } else if (function == peakDivider_) {
+        if (value < 0)
+            return asynError;
+
+        peaks_->divider = value;
+        peaks_->counter = 0;
+        setIntegerParam(peakDivider_, value);
+
+    } else if (function == peakNum_) {
+        if (value < 1 || value > PEAK_MAX)
+            return asynError;
+
+        peaks_->numPeaks = value;
+        setIntegerParam(peakNum_, value);
+
+    } else if (function == anomWarmup_) {
+        if (value < 0)
+            return asynError;
+
+        anomaly_->warmup = value;
+        setIntegerParam(anomWarmup_, value);
+
+    } else if (function == anomRelearn_) {
+        if (value < 0)
+            return asynError;
+
+        anomaly_->relearn = value;
+        setIntegerParam(anomRelearn_, value);
+
+    } else if (function == emCalScans_) {
+        if (value < 1)
+            return asynError;
+
+        emCal_->scans = value;
+        setIntegerParam(emCalScans_, value);
+
+    } else if (function == lifePeriod_) {
+        if (value < 1)
+            return asynError;
+
+        life_->period = value;
+        setIntegerParam(lifePeriod_, value);
+
+    } else if (function == trendChannel_) {
+        if (value < TREND_BOX_TEMP || value > TREND_EM_POT)
+            return asynError;
+
+        trend_->channel = value;
+        setIntegerParam(trendChannel_, value);
+        publishTrends(true);
+
+    } else if (function == streamQueue_) {
+        if (value < 1 || value > STREAM_MAX_QUEUE)
+            return asynError;
+
+        //frames already queued beyond a shorter depth still go out
+        epicsMutexLock(streamLock_);
+        stream_->depth = value;
+        epicsMutexUnlock(streamLock_);
+        setIntegerParam(streamQueue_, value);
+
+    } else if (function == ratioWindow_) {
+        if (value < 1 || value > RATIO_HIST_SIZE)
+            return asynError;
+
+        ratios_->window = value;
+        setIntegerParam(ratioWindow_, value);
+
+    } else if (function == ratioNum_ || function == ratioDen_) {
+        if (chNumber < 1 || chNumber > RATIO_MAX || value < 0 || value > CONV_MAX_MASS)
+            return asynError;
+
+        if (function == ratioNum_)
+            ratios_->entry[chNumber].numMass = value;
+        else
+            ratios_->entry[chNumber].denMass = value;
+        //the old statistics belong to another ratio
+        ratios_->entry[chNumber].count = 0;
+        setIntegerParam(chNumber, function, value);
+
+    } else if (function == airRatio_ || function == waterRatio_) {
+        if (value < 1 || value > RATIO_MAX)
+            return asynError;
+
+        if (function == airRatio_) {
+            ratios_->airEntry = value;
+            ratios_->airLeak = 0;
+            setIntegerParam(airLeak_, 0);
+        } else {
+            ratios_->waterEntry = value;
+            ratios_->waterDominated = 0;
+            setIntegerParam(waterDominated_, 0);
+        }
+        setIntegerParam(function, value);
+
     } else {
         asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
                   "%s::%s port %s invalid pasynUser->reason %d\n",
                   driverName, functionName, this->portName, function);
         return asynError;
     }
+    callParamCallbacks(chNumber);
     return asynSuccess;
 }
 
@@ -553,9 +1623,12 @@ asynStatus drvInficon::writeInt32(asynUser *pasynUser, epicsInt32 value)
 */
 asynStatus drvInficon::readFloat64 (asynUser *pasynUser, epicsFloat64 *value)
 {
-    //int function = pasynUser->reason;
+    int function = pasynUser->reason;
     //static const char *functionName = "readFloat64";
 
+    if (isSetting(function))
+        return asynPortDriver::readFloat64(pasynUser, value);
+
     *value = 0;
 
     return asynSuccess;
@@ -628,12 +1701,188 @@ asynStatus drvInficon::writeFloat64 (asynUser *pasynUser, epicsFloat64 value)
         if (ioStatus_ != asynSuccess)
             return(ioStatus_);
 
+    } else if (function == pressPollTime_) {
+        if (value < MIN_PRESS_POLL_TIME)
+            return asynError;
+
+        pressHistory_->pollTime = value;
+        setDoubleParam(pressPollTime_, value);
+        //wake up the pressure thread so the new period takes effect immediately
+        epicsEventSignal(pressureEventId_);
+
+    } else if (function == pressHistWindow_) {
+        if (value <= 0)
+            return asynError;
+
+        pressHistory_->histWindow = value;
+        setDoubleParam(pressHistWindow_, value);
+
+    } else if (function == pressStatWindow_) {
+        if (value <= 0)
+            return asynError;
+
+        pressHistory_->statWindow = value;
+        setDoubleParam(pressStatWindow_, value);
+
+    } else if (function == capturePressLevel_) {
+        if (value < 0)
+            return asynError;
+
+        capture_->pressLevel = value;
+        setDoubleParam(capturePressLevel_, value);
+
+    } else if (function == capturePressRate_) {
+        if (value < 0)
+            return asynError;
+
+        capture_->pressRate = value;
+        setDoubleParam(capturePressRate_, value);
+
+    } else if (function == statsThreshold_) {
+        scanStats_->threshold = value;
+        setDoubleParam(statsThreshold_, value);
+
+    } else if (function == roiStart_) {
+        if (chNumber < 1 || chNumber > MAX_ROIS || value < 0)
+            return asynError;
+
+        rois_[chNumber].startMass = value;
+        setDoubleParam(chNumber, roiStart_, value);
+
+    } else if (function == roiStop_) {
+        if (chNumber < 1 || chNumber > MAX_ROIS || value < 0)
+            return asynError;
+
+        rois_[chNumber].stopMass = value;
+        setDoubleParam(chNumber, roiStop_, value);
+
+    } else if (function == calThreshold_) {
+        if (value < 0)
+            return asynError;
+
+        cal_->threshold = value;
+        setDoubleParam(calThreshold_, value);
+
+    } else if (function == calMinSnr_) {
+        if (value < 0)
+            return asynError;
+
+        cal_->minSnr = value;
+        setDoubleParam(calMinSnr_, value);
+
+    } else if (function == peakMinSnr_) {
+        if (value < 0)
+            return asynError;
+
+        peaks_->minSnr = value;
+        setDoubleParam(peakMinSnr_, value);
+
+    } else if (function == anomAlpha_) {
+        if (value <= 0 || value > 1)
+            return asynError;
+
+        anomaly_->alpha = value;
+        setDoubleParam(anomAlpha_, value);
+
+    } else if (function == anomThreshold_) {
+        if (value <= 0)
+            return asynError;
+
+        anomaly_->threshold = value;
+        setDoubleParam(anomThreshold_, value);
+
+    } else if (function == ratioWidth_) {
+        if (value <= 0 || value > 0.5)
+            return asynError;
+
+        ratios_->width = value;
+        setDoubleParam(ratioWidth_, value);
+
+    } else if (function == ratioNumWidth_ || function == ratioDenWidth_) {
+        if (chNumber < 1 || chNumber > RATIO_MAX || value <= 0 || value > 0.5)
+            return asynError;
+
+        if (function == ratioNumWidth_)
+            ratios_->entry[chNumber].numWidth = value;
+        else
+            ratios_->entry[chNumber].denWidth = value;
+        ratios_->entry[chNumber].count = 0;
+        setDoubleParam(chNumber, function, value);
+
+    } else if (function == airLow_ || function == airHigh_ || function == waterOn_ || function == waterOff_) {
+        if (value < 0)
+            return asynError;
+
+        if (function == airLow_) ratios_->airLow = value;
+        else if (function == airHigh_) ratios_->airHigh = value;
+        else if (function == waterOn_) ratios_->waterOn = value;
+        else ratios_->waterOff = value;
+        setDoubleParam(function, value);
+
+    } else if (function == consDriftLimit_) {
+        if (value < 0)
+            return asynError;
+
+        consistency_->driftLimit = value;
+        setDoubleParam(consDriftLimit_, value);
+
+    } else if (function == emCalTarget_ || function == emCalTolerance_) {
+        if (value <= 0)
+            return asynError;
+
+        if (function == emCalTarget_)
+            emCal_->target = value;
+        else
+            emCal_->tolerance = value;
+        setDoubleParam(function, value);
+
+    } else if (function == lifeFilLimit_) {
+        if (value <= 0)
+            return asynError;
+
+        life_->filCurrentLimit = value;
+        setDoubleParam(lifeFilLimit_, value);
+        estimateLife();
+
+    } else if (function == trendPeriod_) {
+        //the poller wakes every pollTime_, that is the fastest usable period
+        if (value < pollTime_ || value > 60)
+            return asynError;
+
+        trend_->period = value;
+        setDoubleParam(trendPeriod_, value);
+
+    } else if (function == pollPeriod_) {
+        if (value < MIN_POLL_TIME || value > MAX_POLL_TIME)
+            return asynError;
+
+        //the trend period can't be shorter than a poll
+        if (trend_->period < value) {
+            trend_->period = value;
+            setDoubleParam(trendPeriod_, value);
+        }
+        pollTime_ = value;
+        pollClock_->restart = true;
+        setDoubleParam(pollPeriod_, value);
+        epicsEventSignal(pollerEventId_);
+
+    } else if (function == trendBucket_) {
+        if (chNumber < 1 || chNumber > TREND_SCALES || value < 0)
+            return asynError;
+
+        //points of different widths don't mix, start the scale over
+        trend_->scale[chNumber].bucket = value;
+        setDoubleParam(chNumber, trendBucket_, value);
+        resetTrend(chNumber);
+        publishTrends(false);
+
     } else {
         asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
                   "%s::%s port %s invalid pasynUser->reason %d\n",
                   driverName, functionName, this->portName, function);
         return asynError;
     }
+    callParamCallbacks(chNumber);
     return asynSuccess;
 }
 
@@ -658,9 +1907,12 @@ asynStatus drvInficon::readFloat32Array(asynUser *pasynUser, epicsFloat32 *data,
 */
 asynStatus drvInficon::readOctet(asynUser *pasynUser, char *value, size_t maxChars, size_t *nactual, int *eomReason)
 {
-    //int function = pasynUser->reason;
+    int function = pasynUser->reason;
     //static const char *functionName = "readOctet";
 
+    if (isSetting(function))
+        return asynPortDriver::readOctet(pasynUser, value, maxChars, nactual, eomReason);
+
     *nactual = 0;
 	
     return asynSuccess;
@@ -686,17 +1938,63 @@ asynStatus drvInficon::writeOctet (asynUser *pasynUser, const char *value, size_
 
         ioStatus_ = inficonReadWrite(request, data_);
         if (ioStatus_ != asynSuccess) return(ioStatus_);
-    } else {
-        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
-                  "%s::%s port %s invalid pasynUser->reason %d\n",
-                  driverName, functionName, this->portName, function);
-        return asynError;
-    }
-    return asynSuccess;
-}
+    } else if (function == captureDir_) {
+        if (*nActual == 0 || *nActual >= CAPTURE_PATH_SIZE)
+            return asynError;
 
-static void pollerThreadC(void *drvPvt)
-{
+        strcpy(capture_->directory, value);
+        setStringParam(captureDir_, capture_->directory);
+    } else if (function == seqFile_) {
+        //a new recipe can't be loaded while the current one is running
+        if (mainState_ == SEQUENCE)
+            return asynError;
+
+        setStringParam(seqFile_, value);
+        if (loadSequence(value) != asynSuccess) {
+            callParamCallbacks(chNumber);
+            return asynError;
+        }
+    } else if (function == streamEndpoint_) {
+        struct sockaddr_storage addr;
+        socklen_t addrLen;
+
+        //an empty endpoint stops the server
+        if (*nActual >= CAPTURE_PATH_SIZE || (*nActual > 0 && !parseStreamEndpoint(value, &addr, &addrLen)))
+            return asynError;
+
+        setStringParam(streamEndpoint_, value);
+        epicsMutexLock(streamLock_);
+        strcpy(stream_->endpoint, value);
+        stream_->reconfigure = true;
+        epicsMutexUnlock(streamLock_);
+        if (write(stream_->wakeFd[1], "", 1) < 0) {}
+    } else if (function == lifeFile_) {
+        if (*nActual == 0 || *nActual >= CAPTURE_PATH_SIZE)
+            return asynError;
+
+        setStringParam(lifeFile_, value);
+        if (openLifeStore(value) != asynSuccess) {
+            callParamCallbacks(chNumber);
+            return asynError;
+        }
+    } else if (function == convRsfFile_) {
+        setStringParam(convRsfFile_, value);
+        if (loadRsfTable(value) != asynSuccess) {
+            callParamCallbacks(chNumber);
+            return asynError;
+        }
+    } else {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s port %s invalid pasynUser->reason %d\n",
+                  driverName, functionName, this->portName, function);
+        return asynError;
+    }
+    callParamCallbacks(chNumber);
+    return asynSuccess;
+}
+
+static void pollerThreadC(void *drvPvt)
+{
     drvInficon *pPvt = (drvInficon *)drvPvt;
 
     pPvt->pollerThread();
@@ -715,8 +2013,13 @@ void drvInficon::pollerThread()
     char request[HTTP_REQUEST_SIZE];
     asynStatus status = asynSuccess;
     asynStatus prevIOStatus = asynSuccess;
-    epicsTimeStamp currTime, cycleTimeFiveSec, cycleTimeTenSec;
-    double dTFiveSec, dTTenSec;
+    epicsTimeStamp currTime;
+    epicsTimeStamp cycleTimeFiveSec = {0, 0}, cycleTimeTenSec = {0, 0}, cycleTimeDiag = {0, 0}, trendDue;
+    double dTFiveSec, dTTenSec, dTDiag;
+    unsigned int scanChannel, scanStep;
+    double emCalValue;
+    double waitTime = pollTime_;
+    bool scanning;
 
     static const char *functionName="pollerThread";
 
@@ -728,30 +2031,43 @@ void drvInficon::pollerThread()
         /* Sleep for the poll delay or waiting for epicsEvent with the port unlocked */
         unlock();
 
-        epicsEventWaitWithTimeout(pollerEventId_, pollTime_);
+        epicsEventWaitWithTimeout(pollerEventId_, waitTime);
 
         if (inficonExiting_) break;
 
         epicsTimeGetCurrent(&currTime);
         dTFiveSec = epicsTimeDiffInSeconds(&currTime, &cycleTimeFiveSec);
         dTTenSec = epicsTimeDiffInSeconds(&currTime, &cycleTimeTenSec);
+        dTDiag = epicsTimeDiffInSeconds(&currTime, &cycleTimeDiag);
 
         /* Lock the port.  It is important that the port be locked so other threads cannot access the Inficon
          * structure while the poller thread is running. */
         lock();
 
-        if(dTFiveSec >= 5.) {
-            /*Get diagnostic data*/
+        /*Diagnostic data is sampled at the trend period, the scalar readbacks stay at 5 s*/
+        if(dTDiag >= trend_->period) {
             sprintf(request,"GET /mmsp/diagnosticData/get\r\n"
                             "\r\n");
             /*Read the data*/
             ioStatus_ = inficonReadWrite(request, data_);
 
             status = parseDiagData(data_, diagData_);
-            if (status)
+            if (status) {
                 asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
                           "%s:%s: ERROR parsing device diagnostic data, status=%d\n",
                           driverName, functionName, status);
+            } else {
+                pushTrend(&currTime);
+                lifeAccumulate();
+            }
+            epicsTimeGetCurrent(&cycleTimeDiag);
+        }
+
+        if(dTFiveSec >= 5.) {
+            publish_->trends = true;
+            publishPollClock();
+
+            /*Latest diagnostic sample, whatever the trend period*/
             setDoubleParam(boxTemp_, diagData_->boxTemp);
             setUIntDigitalParam(anodePotential_, diagData_->anodePot, 0xFFFFFFFF);
             setUIntDigitalParam(emiCurrent_, diagData_->emiCurrent, 0xFFFFFFFF);
@@ -878,6 +2194,20 @@ void drvInficon::pollerThread()
             setUIntDigitalParam(systStatus_, devStatus_->systStatus, 0xFFFFFFFF);
             setUIntDigitalParam(hwError_, devStatus_->hwError, 0xFFFFFFFF);
             setUIntDigitalParam(hwWarn_, devStatus_->hwWarn, 0xFFFFFFFF);
+
+            /*The device error log is only read when the fault words change*/
+            if (status == asynSuccess && decodeFaults(devStatus_->hwError, devStatus_->hwWarn)) {
+                sprintf(request,"GET /mmsp/communication/errorLog/get\r\n"
+                                "\r\n");
+                ioStatus_ = inficonReadWrite(request, data_);
+                if (ioStatus_ == asynSuccess &&
+                    parseErrorLog(data_, faults_->errorLog, sizeof(faults_->errorLog)) == asynSuccess)
+                    setStringParam(errorLog_, faults_->errorLog);
+                else
+                    asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                              "%s:%s: ERROR reading device error log\n",
+                              driverName, functionName);
+            }
             setDoubleParam(pwrOnTime_, devStatus_->pwrOnTime);
             setDoubleParam(emiOnTime_, devStatus_->emiOnTime);
             setDoubleParam(emOnTime_, devStatus_->emOnTime);
@@ -928,18 +2258,13 @@ void drvInficon::pollerThread()
         setUIntDigitalParam(scanStatus_, scanInfo_->scanStatus, 0x1);
         setUIntDigitalParam(pointsInScan_, scanInfo_->pointsInScan, 0xFFFFFFFF);
 
-        /*Get pressure value*/
-        sprintf(request,"GET /mmsp/measurement/totalPressure/get\r\n"
-                        "\r\n");
-        /*Read the data*/
-        ioStatus_ = inficonReadWrite(request, data_);
+        //while scanning the next wake up follows the predicted end of the scan
+        scanning = (status == asynSuccess && scanInfo_->scanStatus == 1 &&
+                    (mainState_ == MONITORING || mainState_ == SEQUENCE));
+        if (scanning)
+            predictScan((mainState_ == SEQUENCE) ? sequence_->step[sequence_->currStep].channel : 3);
 
-        status = parsePressure(data_, &totalPressure_);
-        if (status)
-            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
-                      "%s:%s: ERROR parsing total pressure data, status=%d\n",
-                      driverName, functionName, status);
-        setDoubleParam(getPress_, totalPressure_);
+        /*Total pressure is sampled by the pressure thread*/
 
         //let's check if the leakcheck is running, and start pulling leakcheck data
         if(mainState_ == LEAKCEHCK && scanInfo_->scanStatus == 1) {
@@ -967,44 +2292,75 @@ void drvInficon::pollerThread()
             }
         }
 
-        //let's check if the monitoring is running, and start pulling data
-        if(mainState_ == MONITORING && scanInfo_->scanStatus == 1) {
-            if (startingMonitor_) {
-                startingMonitor_ = false;
-                lastPolledScan_ = -1;
-                //set elements of scan array to 0
-                memset(scanData_->scanValues, 0, MAX_SCAN_SIZE*sizeof(float));
-                //clear screen for the user, array size from previous scan
-                doCallbacksFloat32Array(scanData_->scanValues, scanData_->scanSize, getScan_, 0);
-
-                //set elements of x cooridnate array to 0
-                memset(scanData_->amuValues, 0, MAX_SCAN_SIZE*sizeof(float));
-                //clear screen for the user, array size from previous scan
-                doCallbacksFloat32Array(scanData_->amuValues, scanData_->scanSize, getXCoord_, 0);
-            }
-
+        //EM gain calibration takes one reading per completed single mass scan
+        if (mainState_ == EMCAL && scanInfo_->scanStatus == 1) {
             if (scanInfo_->lastScan > lastPolledScan_) {
-                /*Get scan values from last successfull scan*/
                 sprintf(request,"GET /mmsp/measurement/scans/-1/get\r\n"
                                 "\r\n");
-                /*Read the data*/
                 ioStatus_ = inficonReadWrite(request, data_);
 
-		        status = parseScan(data_, scanData_);
+                status = parseLeakChk(data_, &emCalValue);
                 if (status)
                     asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
-                              "%s:%s: ERROR parsing leakcheck data, status=%d\n",
+                              "%s:%s: ERROR parsing EM calibration data, status=%d\n",
                               driverName, functionName, status);
+                else
+                    emCalReading(scanInfo_->lastScan, emCalValue);
 
-                //update x coordinate data
-                doCallbacksFloat32Array(scanData_->amuValues, scanData_->scanSize, getXCoord_, 0);
+                lastPolledScan_ = scanInfo_->lastScan;
+            }
+        }
+
+        //let's check if the monitoring or a sequence is running, and start pulling data
+        if((mainState_ == MONITORING || mainState_ == SEQUENCE) && scanInfo_->scanStatus == 1) {
+            if (startingMonitor_) {
+                startingMonitor_ = false;
+                lastPolledScan_ = -1;
+                memset(scanData_->scanValues, 0, MAX_SCAN_SIZE*sizeof(float));
+                memset(scanData_->amuValues, 0, MAX_SCAN_SIZE*sizeof(float));
+                memset(decim_->scanValues, 0, MAX_DECIM_SIZE*sizeof(float));
+                memset(decim_->amuValues, 0, MAX_DECIM_SIZE*sizeof(float));
+
+                //a spectrum still on its way belongs to the previous run
+                if (bulk_->busy)
+                    bulk_->discard = true;
+                scanPredict_->channel = -1;
+                //the publish thread clears the screen for the user and drops older scans
+                epicsMutexLock(publishLock_);
+                publish_->scanPending = false;
+                publish_->clear = true;
+                publish_->generation++;
+                epicsMutexUnlock(publishLock_);
+                epicsEventSignal(publishEventId_);
+            }
 
-                //update scan/measurement data
-                doCallbacksFloat32Array(scanData_->scanValues, scanData_->scanSize, getScan_, 0);
+            //the spectrum itself is read by the bulk thread, one at a time
+            if (scanInfo_->lastScan > lastPolledScan_ && !bulk_->busy) {
+                //in a sequence the scan belongs to the step that was active when it started
+                scanChannel = 3;
+                if (mainState_ == SEQUENCE) {
+                    if (sequence_->stepFirstScan < 0)
+                        sequence_->stepFirstScan = scanInfo_->lastScan;
+                    scanStep = (scanInfo_->lastScan >= sequence_->stepFirstScan) ? sequence_->currStep : sequence_->prevStep;
+                    scanChannel = sequence_->step[scanStep].channel;
+                    setIntegerParam(scanStep_, scanStep);
+                    setStringParam(scanStepName_, sequence_->step[scanStep].name);
+                }
+
+                bulk_->channel = scanChannel;
+                bulk_->scanEnd = scanPredict_->doneEstimate;
+                bulk_->scanPeriod = scanPredict_->period;
+                bulk_->busy = true;
+                epicsEventSignal(bulkEventId_);
 
                 //update last polled scan number 
                 lastPolledScan_ = scanInfo_->lastScan;
             }
+
+            //move on once the current step has completed all its scans
+            if (mainState_ == SEQUENCE && sequence_->stepFirstScan >= 0 &&
+                scanInfo_->lastScan - sequence_->stepFirstScan + 1 >= (int)sequence_->step[sequence_->currStep].scans)
+                advanceSequence();
         }
 
 
@@ -1026,15 +2382,104 @@ void drvInficon::pollerThread()
             lock();
         }
 
-        for (int i=0; i<MAX_CHANNELS; i++) {
-            callParamCallbacks(i);
-        }
+        publishLaneStats();
+        if (forceCallback_)
+            dirtyAddr_ = (1u << MAX_CHANNELS) - 1;
+        requestPublish();
         //unlock();
         /* Reset the forceCallback flag */
         forceCallback_ = false;
 
         /* Set the previous I/O status */
         prevIOStatus = ioStatus_;
+
+        //sleep until the next tick of the poll clock, or the predicted end of the scan
+        trendDue = cycleTimeDiag;
+        epicsTimeAddSeconds(&trendDue, trend_->period);
+        waitTime = scanWaitTime(scanning, pollClockTick(&currTime), &trendDue);
+    }
+}
+
+
+static void pressureThreadC(void *drvPvt)
+{
+    drvInficon *pPvt = (drvInficon *)drvPvt;
+
+    pPvt->pressureThread();
+}
+
+
+/*
+****************************************************************************
+** Pressure thread for total pressure sampling
+   One instance spawned per asyn port, runs on its own period
+   (PRESS_POLL_TIME) independent of the poller cycle
+****************************************************************************
+*/
+
+void drvInficon::pressureThread()
+{
+    char request[HTTP_REQUEST_SIZE];
+    asynStatus status = asynSuccess;
+    epicsTimeStamp requestTime, sampleTime, publishTime;
+    double waitTime;
+
+    static const char *functionName="pressureThread";
+
+    epicsTimeGetCurrent(&publishTime);
+
+    sprintf(request,"GET /mmsp/measurement/totalPressure/get\r\n"
+                    "\r\n");
+
+    lock();
+
+    /* Loop forever */
+    while (1)
+    {
+        /* On I/O error back off like the poller does */
+        waitTime = (status == asynSuccess) ? pressHistory_->pollTime : 1.0;
+
+        unlock();
+
+        epicsEventWaitWithTimeout(pressureEventId_, waitTime);
+
+        if (inficonExiting_) break;
+
+        /*Read the pressure on its own connection and buffer, the poller keeps the port meanwhile*/
+        epicsTimeGetCurrent(&requestTime);
+        status = inficonReadWrite(request, pressData_, LANE_PRESSURE);
+        epicsTimeGetCurrent(&sampleTime);
+        //nothing queues ahead on this connection, the device sampled about half way
+        epicsTimeAddSeconds(&sampleTime, -0.5 * epicsTimeDiffInSeconds(&sampleTime, &requestTime));
+
+        lock();
+        if (status != asynSuccess)
+            continue;
+
+        status = parsePressure(pressData_, &totalPressure_);
+        if (status) {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                      "%s:%s: ERROR parsing total pressure data, status=%d\n",
+                      driverName, functionName, status);
+            continue;
+        }
+
+        pushPressure(&sampleTime, totalPressure_);
+        checkCaptureTrigger(&sampleTime, totalPressure_);
+
+        /* Don't do callbacks until EPICS interruptAccept flag is set */
+        if (!interruptAccept)
+            continue;
+
+        setDoubleParam(getPress_, totalPressure_);
+
+        /* The history waveform is published at the poller rate, not every sample */
+        if (epicsTimeDiffInSeconds(&sampleTime, &publishTime) >= pollTime_) {
+            publishPressHist();
+            publishTime = sampleTime;
+        }
+
+        requestPublish();
     }
 }
 
@@ -1043,7 +2488,7 @@ void drvInficon::pollerThread()
 /*
 **  User functions
 */
-asynStatus drvInficon::inficonReadWrite(const char *request, char *response)
+asynStatus drvInficon::inficonReadWrite(const char *request, char *response, httpLane_t lane)
 {
     asynStatus status = asynSuccess;
     int eomReason;
@@ -1052,6 +2497,10 @@ asynStatus drvInficon::inficonReadWrite(const char *request, char *response)
     int requestSize = 0;
 	//int responseSize = 0;
 	char httpResponse[HTTP_RESPONSE_SIZE];
+    asynUser *pasynUserLane = (lane == LANE_BULK) ? pasynUserBulk_ :
+                              (lane == LANE_PRESSURE) ? pasynUserPress_ : pasynUserOctet_;
+    laneStatsStruct *ls = &laneStats_[lane];
+    epicsTimeStamp startTime, stopTime;
 
     static const char *functionName = "inficonReadWrite";
 	
@@ -1105,7 +2554,8 @@ asynStatus drvInficon::inficonReadWrite(const char *request, char *response)
     /* Do the write/read cycle */
 	requestSize = (int)strlen(request);
 	//responseSize = HTTP_RESPONSE_SIZE;
-    status = pasynOctetSyncIO->writeRead(pasynUserOctet_,
+    epicsTimeGetCurrent(&startTime);
+    status = pasynOctetSyncIO->writeRead(pasynUserLane,
                                          request, requestSize,
                                          httpResponse, HTTP_RESPONSE_SIZE,
                                          DEVICE_RW_TIMEOUT,
@@ -1114,6 +2564,17 @@ asynStatus drvInficon::inficonReadWrite(const char *request, char *response)
               "%s::%s port %s called pasynOctetSyncIO->writeRead, status=%d, requestSize=%d, nwrite=%d, nread=%d, eomReason=%d request:%s\n",
               driverName, functionName, this->portName, status, requestSize, (int)nwrite, (int)nread, eomReason, request);
 
+    //the bulk thread gets here without the port lock
+    epicsTimeGetCurrent(&stopTime);
+    epicsMutexLock(laneLock_);
+    ls->requests++;
+    ls->lastLatency = epicsTimeDiffInSeconds(&stopTime, &startTime) * 1000.0;
+    ls->sumLatency += ls->lastLatency;
+    if (ls->lastLatency > ls->maxLatency)
+        ls->maxLatency = ls->lastLatency;
+    ls->bytes += nread;
+    epicsMutexUnlock(laneLock_);
+
     /*if (status != prevIOStatus_) {
         if (status != asynSuccess) {
             asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
@@ -1213,6 +2674,11 @@ asynStatus drvInficon::inficonReadWrite(const char *request, char *response)
               "%s::%s status=%d\n",
               driverName, functionName, status);
     done:
+    if (status != asynSuccess) {
+        epicsMutexLock(laneLock_);
+        ls->errors++;
+        epicsMutexUnlock(laneLock_);
+    }
     return status;
 }
 
@@ -1483,6 +2949,14 @@ asynStatus drvInficon::parseChScanSetup(const char *jsonData, chScanSetupStruct
         chScanSetup[chNumber].chStopMass = j["data"][0]["stopMass"];
         chScanSetup[chNumber].chDwell = j["data"][0]["dwell"];
         chScanSetup[chNumber].chPpamu = j["data"][0]["ppamu"];
+        //a missing flag counts as enabled, the device may give it as True/False text
+        chScanSetup[chNumber].chEnabled = true;
+        if (j["data"][0].contains("enabled")) {
+            if (j["data"][0]["enabled"].is_string())
+                chScanSetup[chNumber].chEnabled = (j["data"][0]["enabled"] == "True");
+            else
+                chScanSetup[chNumber].chEnabled = j["data"][0]["enabled"];
+        }
     }
 	catch (const json::parse_error& e) {
         asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
@@ -1499,7 +2973,7 @@ asynStatus drvInficon::parseChScanSetup(const char *jsonData, chScanSetupStruct
     return asynSuccess;
 }
 
-asynStatus drvInficon::parseScan(const char *jsonData, scanDataStruct *scanData)
+asynStatus drvInficon::parseScan(const char *jsonData, scanDataStruct *scanData, unsigned int chNumber)
 {
     unsigned int ppAMU = 0;
     double dAMU = 0;
@@ -1530,9 +3004,9 @@ asynStatus drvInficon::parseScan(const char *jsonData, scanDataStruct *scanData)
     }
 	
     /*calculate x coordinate data points*/
-    getDoubleParam(3, chStartMass_, &startMass);
-    getDoubleParam(3, chStopMass_, &stopMass);
-    getUIntDigitalParam(3, chPpamu_, &ppAMU, 0xFFFFFFFF);
+    getDoubleParam(chNumber, chStartMass_, &startMass);
+    getDoubleParam(chNumber, chStopMass_, &stopMass);
+    getUIntDigitalParam(chNumber, chPpamu_, &ppAMU, 0xFFFFFFFF);
 
 	if (ppAMU <= 0) {
         asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
@@ -1560,7 +3034,58 @@ asynStatus drvInficon::parseScan(const char *jsonData, scanDataStruct *scanData)
     for(int i = 0; i < (int)scanData->scanSize; i++) {
         scanData->amuValues[i] = startMass + (i*dAMU);
     }
+    scanData->startMass = startMass;
+    scanData->stopMass = stopMass;
+    scanData->ppamu = ppAMU;
+
+    return asynSuccess;
+}
+
+asynStatus drvInficon::parseScanChannels(const char *jsonData, unsigned int *startChannel, unsigned int *stopChannel)
+{
+    static const char *functionName = "parseScanChannels";
+
+    try {
+        json j = json::parse(jsonData);
+
+        *startChannel = j["data"]["startChannel"];
+        *stopChannel = j["data"]["stopChannel"];
+    }
+	catch (const json::parse_error& e) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s JSON error parsing string: %s\n", driverName, functionName, e.what());
+        return asynError;
+    }
+    catch (std::exception& e) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s other error parsing string: %s\n", driverName, functionName, e.what());
+        return asynError;
+    }
+    return asynSuccess;
+}
+
+asynStatus drvInficon::parseEmState(const char *jsonData, unsigned int *emOn)
+{
+    static const char *functionName = "parseEmState";
 
+    try {
+        json j = json::parse(jsonData);
+
+        if (j["data"]["setEM"].is_boolean())
+            *emOn = j["data"]["setEM"].get<bool>() ? 1 : 0;
+        else
+            *emOn = j["data"]["setEM"];
+    }
+	catch (const json::parse_error& e) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s JSON error parsing string: %s\n", driverName, functionName, e.what());
+        return asynError;
+    }
+    catch (std::exception& e) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s other error parsing string: %s\n", driverName, functionName, e.what());
+        return asynError;
+    }
     return asynSuccess;
 }
 
@@ -1696,6 +3221,3039 @@ asynStatus drvInficon::parseSensIonSource(const char *jsonData, sensIonSourceStr
     return asynSuccess;
 }
 
+/* Add a total pressure sample to the history ring buffer */
+void drvInficon::pushPressure(const epicsTimeStamp *sampleTime, double value)
+{
+    pressHistStruct *hist = pressHistory_;
+
+    hist->sampleTime[hist->head] = sampleTime->secPastEpoch + sampleTime->nsec * 1e-9;
+    hist->sampleValue[hist->head] = (float)value;
+    hist->head = (hist->head + 1) % PRESS_HIST_SIZE;
+    if (hist->count < PRESS_HIST_SIZE)
+        hist->count++;
+}
+
+/* Publish the last histWindow seconds of total pressure and min/max/mean over statWindow */
+void drvInficon::publishPressHist()
+{
+    pressHistStruct *hist = pressHistory_;
+    unsigned int idx;
+    unsigned int nHist = 0;
+    unsigned int nStat = 0;
+    double newest, age;
+    double min = 0, max = 0, sum = 0;
+
+    if (hist->count == 0)
+        return;
+
+    newest = hist->sampleTime[(hist->head + PRESS_HIST_SIZE - 1) % PRESS_HIST_SIZE];
+
+    //walk back from the newest sample until both windows are covered
+    for (unsigned int i = 0; i < hist->count; i++) {
+        idx = (hist->head + PRESS_HIST_SIZE - 1 - i) % PRESS_HIST_SIZE;
+        age = newest - hist->sampleTime[idx];
+        if (age > hist->histWindow && age > hist->statWindow)
+            break;
+        if (age <= hist->histWindow)
+            nHist++;
+        if (age <= hist->statWindow) {
+            float value = hist->sampleValue[idx];
+            if (nStat == 0 || value < min) min = value;
+            if (nStat == 0 || value > max) max = value;
+            sum += value;
+            nStat++;
+        }
+    }
+
+    //copy the waveform window in chronological order
+    for (unsigned int i = 0; i < nHist; i++) {
+        idx = (hist->head + PRESS_HIST_SIZE - nHist + i) % PRESS_HIST_SIZE;
+        hist->histValues[i] = hist->sampleValue[idx];
+        hist->histTime[i] = (float)(hist->sampleTime[idx] - newest);
+    }
+
+    setDoubleParam(pressMin_, min);
+    setDoubleParam(pressMax_, max);
+    setDoubleParam(pressMean_, (nStat > 0) ? sum/nStat : 0);
+
+    queueArray(hist->histTime, nHist, pressHistTime_, 0);
+    queueArray(hist->histValues, nHist, pressHist_, 0);
+}
+
+static void captureThreadC(void *drvPvt)
+{
+    drvInficon *pPvt = (drvInficon *)drvPvt;
+
+    pPvt->captureThread();
+}
+
+
+/*
+****************************************************************************
+** Capture thread writing frozen event captures to file
+   One instance spawned per asyn port, works without holding the port
+   lock so acquisition is never stalled by file I/O
+****************************************************************************
+*/
+
+void drvInficon::captureThread()
+{
+    char fileName[CAPTURE_PATH_SIZE];
+    asynStatus status;
+
+    static const char *functionName="captureThread";
+
+    while (1)
+    {
+        epicsEventWait(captureEventId_);
+
+        if (inficonExiting_) break;
+
+        /* The dump part of capture_ belongs to this thread until writerBusy is cleared */
+        status = writeCapture(fileName);
+
+        lock();
+        if (status == asynSuccess) {
+            capture_->captures++;
+            strcpy(capture_->lastFile, fileName);
+            setIntegerParam(captureCount_, capture_->captures);
+            setStringParam(captureFile_, capture_->lastFile);
+            asynPrint(pasynUserSelf, ASYN_TRACE_FLOW,
+                      "%s::%s wrote %s\n",
+                      driverName, functionName, fileName);
+        }
+        capture_->writerBusy = false;
+        setUIntDigitalParam(captureBusy_, 0, 0x1);
+        requestPublish();
+        unlock();
+    }
+}
+
+/* Add a new spectrum to the rolling pre-trigger buffer with its own mass axis and the
+ * time it completed, called by the bulk thread */
+void drvInficon::captureScan(const scanDataStruct *scanData, int channel, const epicsTimeStamp *scanEnd)
+{
+    captureStruct *cap = capture_;
+    captureScanStruct *slot;
+
+    if (cap->state == CAPTURE_DISARMED)
+        return;
+
+    slot = &cap->scans[cap->head];
+    slot->scanNumber = scanData->scanNumber;
+    slot->scanSize = (scanData->scanSize < MAX_SCAN_SIZE) ? scanData->scanSize : MAX_SCAN_SIZE;
+    slot->channel = channel;
+    slot->massStart = scanData->startMass;
+    slot->massStep = (scanData->ppamu > 0) ? 1.0/scanData->ppamu : 0;
+    slot->timeStamp = scanEnd->secPastEpoch + scanEnd->nsec * 1e-9;
+    slot->totalPressure = totalPressure_;
+    memcpy(slot->scanValues, scanData->scanValues, slot->scanSize * sizeof(float));
+    cap->head = (cap->head + 1) % CAPTURE_RING_SIZE;
+    if (cap->count < CAPTURE_RING_SIZE)
+        cap->count++;
+
+    if (cap->state == CAPTURE_TRIGGERED) {
+        cap->postTaken++;
+        if (cap->postTaken >= cap->postScans)
+            freezeCapture();
+    }
+}
+
+/* Check the pressure level and rate triggers, called by the pressure thread */
+void drvInficon::checkCaptureTrigger(const epicsTimeStamp *sampleTime, double value)
+{
+    captureStruct *cap = capture_;
+    double now = sampleTime->secPastEpoch + sampleTime->nsec * 1e-9;
+    double dt = now - cap->lastPressTime;
+    bool levelTrig = false;
+    bool rateTrig = false;
+
+    if (cap->state == CAPTURE_ARMED && cap->lastPressTime > 0) {
+        //level trigger fires on the rising edge only
+        levelTrig = (cap->pressLevel > 0 && value >= cap->pressLevel && cap->lastPressValue < cap->pressLevel);
+        rateTrig = (cap->pressRate > 0 && dt > 0 && (value - cap->lastPressValue)/dt >= cap->pressRate);
+    }
+
+    cap->lastPressTime = now;
+    cap->lastPressValue = value;
+
+    if (levelTrig)
+        triggerCapture(CAPTURE_TRIG_PRESS_LEVEL);
+    else if (rateTrig)
+        triggerCapture(CAPTURE_TRIG_PRESS_RATE);
+}
+
+/* Start collecting post-trigger scans, the pre-trigger scans are the ones already in the buffer */
+void drvInficon::triggerCapture(captureTrigger_t trigger)
+{
+    captureStruct *cap = capture_;
+    epicsTimeStamp now;
+    static const char *functionName = "triggerCapture";
+
+    if (cap->state != CAPTURE_ARMED || cap->writerBusy) {
+        if (cap->state != CAPTURE_DISARMED) {
+            cap->missed++;
+            setIntegerParam(captureMissed_, cap->missed);
+        }
+        return;
+    }
+
+    epicsTimeGetCurrent(&now);
+    cap->trigger = trigger;
+    cap->triggerTime = now.secPastEpoch + now.nsec * 1e-9;
+    cap->preTaken = (cap->count < cap->preScans) ? cap->count : cap->preScans;
+    cap->postTaken = 0;
+    cap->state = CAPTURE_TRIGGERED;
+    setUIntDigitalParam(captureState_, cap->state, 0xF);
+
+    asynPrint(pasynUserSelf, ASYN_TRACE_FLOW,
+              "%s::%s trigger source %d\n",
+              driverName, functionName, (int)trigger);
+
+    if (cap->postScans == 0)
+        freezeCapture();
+}
+
+/* Copy the pre and post-trigger scans to the dump buffer and hand it to the capture thread */
+void drvInficon::freezeCapture()
+{
+    captureStruct *cap = capture_;
+    pressHistStruct *hist = pressHistory_;
+    unsigned int n = cap->preTaken + cap->postTaken;
+    unsigned int first = (cap->head + CAPTURE_RING_SIZE - n) % CAPTURE_RING_SIZE;
+    double startTime;
+    unsigned int idx;
+
+    for (unsigned int i = 0; i < n; i++) {
+        const captureScanStruct *src = &cap->scans[(first + i) % CAPTURE_RING_SIZE];
+        captureScanStruct *dst = &cap->dump[i];
+        dst->scanNumber = src->scanNumber;
+        dst->scanSize = src->scanSize;
+        dst->channel = src->channel;
+        dst->massStart = src->massStart;
+        dst->massStep = src->massStep;
+        dst->timeStamp = src->timeStamp;
+        dst->totalPressure = src->totalPressure;
+        memcpy(dst->scanValues, src->scanValues, src->scanSize * sizeof(float));
+    }
+    cap->dumpCount = n;
+    cap->dumpPre = cap->preTaken;
+    cap->dumpTrigger = cap->trigger;
+    cap->dumpTriggerTime = cap->triggerTime;
+    strcpy(cap->dumpDirectory, cap->directory);
+
+    //total pressure covering the captured scans, one scan period before the first one
+    startTime = cap->triggerTime;
+    if (n > 0) {
+        startTime = cap->dump[0].timeStamp;
+        if (n > 1)
+            startTime -= (cap->dump[n-1].timeStamp - cap->dump[0].timeStamp)/(n - 1);
+    }
+    cap->dumpPressCount = 0;
+    for (unsigned int i = hist->count; i > 0; i--) {
+        idx = (hist->head + PRESS_HIST_SIZE - i) % PRESS_HIST_SIZE;
+        if (hist->sampleTime[idx] < startTime)
+            continue;
+        cap->dumpPressTime[cap->dumpPressCount] = hist->sampleTime[idx];
+        cap->dumpPressValue[cap->dumpPressCount] = hist->sampleValue[idx];
+        cap->dumpPressCount++;
+    }
+
+    cap->writerBusy = true;
+    cap->state = cap->armed ? CAPTURE_ARMED : CAPTURE_DISARMED;
+    setUIntDigitalParam(captureBusy_, 1, 0x1);
+    setUIntDigitalParam(captureState_, cap->state, 0xF);
+
+    epicsEventSignal(captureEventId_);
+}
+
+/* Write the dump buffer to a timestamped json file, runs on the capture thread */
+asynStatus drvInficon::writeCapture(char *fileName)
+{
+    const captureStruct *cap = capture_;
+    static const char *triggerNames[] = {"external", "pressureLevel", "pressureRate"};
+    epicsTimeStamp trigTime;
+    char stamp[40];
+    FILE *fp;
+    static const char *functionName = "writeCapture";
+
+    trigTime.secPastEpoch = (epicsUInt32)cap->dumpTriggerTime;
+    trigTime.nsec = (epicsUInt32)((cap->dumpTriggerTime - trigTime.secPastEpoch) * 1e9);
+    epicsTimeToStrftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S.%03f", &trigTime);
+    epicsSnprintf(fileName, CAPTURE_PATH_SIZE, "%s/%s_%s.json", cap->dumpDirectory, this->portName, stamp);
+
+    try {
+        json j;
+        json scans = json::array();
+        std::vector<double> pressTime(cap->dumpPressCount);
+        std::vector<float> pressValue(cap->dumpPressValue, cap->dumpPressValue + cap->dumpPressCount);
+
+        //times are written as POSIX seconds
+        j["port"] = this->portName;
+        j["trigger"] = triggerNames[cap->dumpTrigger];
+        j["triggerTime"] = cap->dumpTriggerTime + POSIX_TIME_AT_EPICS_EPOCH;
+        j["preScans"] = cap->dumpPre;
+        j["postScans"] = cap->dumpCount - cap->dumpPre;
+        for (unsigned int i = 0; i < cap->dumpCount; i++) {
+            const captureScanStruct *scan = &cap->dump[i];
+            json js;
+            js["scannum"] = scan->scanNumber;
+            js["channel"] = scan->channel;
+            js["time"] = scan->timeStamp + POSIX_TIME_AT_EPICS_EPOCH;
+            js["massStart"] = scan->massStart;
+            js["massStep"] = scan->massStep;
+            js["totalPressure"] = scan->totalPressure;
+            js["values"] = std::vector<float>(scan->scanValues, scan->scanValues + scan->scanSize);
+            scans.push_back(js);
+        }
+        j["scans"] = scans;
+        for (unsigned int i = 0; i < cap->dumpPressCount; i++)
+            pressTime[i] = cap->dumpPressTime[i] + POSIX_TIME_AT_EPICS_EPOCH;
+        j["pressure"]["time"] = pressTime;
+        j["pressure"]["values"] = pressValue;
+
+        fp = fopen(fileName, "w");
+        if (fp == NULL) {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                      "%s::%s can't open %s\n",
+                      driverName, functionName, fileName);
+            return asynError;
+        }
+        fputs(j.dump().c_str(), fp);
+        fclose(fp);
+    }
+    catch (std::exception& e) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+            "%s::%s error writing capture: %s\n", driverName, functionName, e.what());
+        return asynError;
+    }
+    return asynSuccess;
+}
+
+/* Tag a new scan with the gate that was active for most of its acquisition window
+ * and add it to that gate's average. Returns the gate number, 0 if no gate overlapped. */
+int drvInficon::gateScan(const scanDataStruct *scanData, const epicsTimeStamp *scanEnd, double period)
+{
+    gateStruct *g = gates_;
+    double end, start, from;
+    double overlap[MAX_GATES + 1] = {0};
+    int value = 0;
+    int tag = 0;
+    unsigned int idx, size;
+
+    //the scan was acquired during the measured scan period before it completed,
+    //until that is known it started when the previous one completed
+    end = scanEnd->secPastEpoch + scanEnd->nsec * 1e-9;
+    if (period > 0)
+        start = end - period;
+    else
+        start = (g->lastScanTime > 0 && g->lastScanTime < end) ? g->lastScanTime : end - pollTime_;
+    g->lastScanTime = end;
+
+    if (g->mode == GATE_OFF)
+        return 0;
+
+    //integrate how long each gate was active within [start, end]
+    from = start;
+    for (unsigned int i = g->count; i > 0; i--) {
+        idx = (g->head + GATE_HIST_SIZE - i) % GATE_HIST_SIZE;
+        //changes after the scan completed don't count, the body is read later
+        if (g->histTime[idx] >= end)
+            break;
+        if (g->histTime[idx] > from) {
+            overlap[value] += g->histTime[idx] - from;
+            from = g->histTime[idx];
+        }
+        value = g->histGate[idx];
+    }
+    overlap[value] += end - from;
+
+    for (int i = 1; i <= MAX_GATES; i++) {
+        if (overlap[i] > 0 && (tag == 0 || overlap[i] > overlap[tag]))
+            tag = i;
+    }
+
+    setIntegerParam(gateTag_, tag);
+    if (tag == 0)
+        return 0;
+
+    //restart the average if the scan setup changed, scans of another mass range can't be mixed
+    size = (scanData->scanSize < MAX_SCAN_SIZE) ? scanData->scanSize : MAX_SCAN_SIZE;
+    if (g->avgCount[tag] == 0 || g->avgSize[tag] != size || g->avgStartMass[tag] != scanData->startMass ||
+        g->avgStopMass[tag] != scanData->stopMass || g->avgPpamu[tag] != scanData->ppamu) {
+        memset(g->avgSum[tag], 0, MAX_SCAN_SIZE*sizeof(double));
+        g->avgSize[tag] = size;
+        g->avgStartMass[tag] = scanData->startMass;
+        g->avgStopMass[tag] = scanData->stopMass;
+        g->avgPpamu[tag] = scanData->ppamu;
+        g->avgCount[tag] = 0;
+        g->axisDirty |= 1u << tag;
+    }
+
+    double *sum = g->avgSum[tag];
+    const float *values = scanData->scanValues;
+    for (unsigned int i = 0; i < size; i++)
+        sum[i] += values[i];
+    g->avgCount[tag]++;
+    g->dirty |= 1u << tag;
+
+    setIntegerParam(tag, gateCount_, g->avgCount[tag]);
+
+    return tag;
+}
+
+/* Send the averages of the gates that got a scan since the last call, and the mass axis
+ * of those whose average was restarted. The gates share one output buffer, so this runs
+ * on the publish thread with the port locked. */
+void drvInficon::publishGates()
+{
+    gateStruct *g = gates_;
+    unsigned int size;
+    double scale, step;
+
+    for (int tag = 1; tag <= MAX_GATES; tag++) {
+        if (!(g->dirty & (1u << tag)) || g->avgCount[tag] == 0)
+            continue;
+        size = g->avgSize[tag];
+        if (g->axisDirty & (1u << tag)) {
+            step = (g->avgPpamu[tag] > 0) ? 1.0/g->avgPpamu[tag] : 0;
+            for (unsigned int i = 0; i < size; i++)
+                g->avgMass[i] = (float)(g->avgStartMass[tag] + i*step);
+            doCallbacksFloat32Array(g->avgMass, size, gateXCoord_, tag);
+        }
+        scale = 1.0/g->avgCount[tag];
+        for (unsigned int i = 0; i < size; i++)
+            g->avgValues[i] = (float)(g->avgSum[tag][i] * scale);
+        doCallbacksFloat32Array(g->avgValues, size, gateAvg_, tag);
+    }
+    g->dirty = 0;
+    g->axisDirty = 0;
+}
+
+/* Clear all per-gate averages */
+void drvInficon::resetGates()
+{
+    gates_->dirty = 0;
+    gates_->axisDirty = 0;
+    for (int i = 0; i <= MAX_GATES; i++) {
+        gates_->avgCount[i] = 0;
+        gates_->avgSize[i] = 0;
+        if (i > 0)
+            setIntegerParam(i, gateCount_, 0);
+    }
+}
+
+/* Load and validate a sequence recipe (json), e.g.
+ * {
+ *   "cycles": 0,
+ *   "channels": [
+ *     {"channel": 1, "channelMode": "Sweep", "startMass": 1, "stopMass": 50, "dwell": 16, "ppamu": 10},
+ *     {"channel": 2, "channelMode": "Single", "startMass": 28, "stopMass": 28, "dwell": 64, "ppamu": 1}
+ *   ],
+ *   "steps": [
+ *     {"name": "survey", "channel": 1, "scans": 2},
+ *     {"name": "N2", "channel": 2, "scans": 10}
+ *   ]
+ * }
+ * cycles = 0 repeats the steps until SCAN_STOP.
+ */
+asynStatus drvInficon::loadSequence(const char *fileName)
+{
+    seqStruct *seq = sequence_;
+    FILE *fp;
+    static const char *functionName = "loadSequence";
+
+    seq->loaded = false;
+    seq->numSteps = 0;
+    setIntegerParam(seqSteps_, 0);
+
+    fp = fopen(fileName, "r");
+    if (fp == NULL) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s can't open %s\n",
+                  driverName, functionName, fileName);
+        return asynError;
+    }
+
+    try {
+        json j = json::parse(fp);
+        std::string jstring;
+        unsigned int ch;
+        int scans;
+
+        fclose(fp);
+        fp = NULL;
+
+        seq->cycles = j.value("cycles", 0);
+
+        for (int i = 0; i < MAX_CHANNELS; i++)
+            seq->channelUsed[i] = false;
+        for (auto& channel : j["channels"]) {
+            ch = channel["channel"];
+            if (ch < 1 || ch >= MAX_CHANNELS) {
+                asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                          "%s::%s channel %u not valid\n",
+                          driverName, functionName, ch);
+                return asynError;
+            }
+            chScanSetupStruct *setup = &seq->channel[ch];
+            jstring = channel["channelMode"];
+            epicsSnprintf(setup->chMode, sizeof(setup->chMode), "%s", jstring.c_str());
+            setup->chStartMass = channel["startMass"];
+            setup->chStopMass = channel["stopMass"];
+            setup->chDwell = channel["dwell"];
+            setup->chPpamu = channel["ppamu"];
+            setup->chEnabled = true;
+            if (setup->chStartMass > setup->chStopMass || setup->chPpamu == 0) {
+                asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                          "%s::%s channel %u setup not valid\n",
+                          driverName, functionName, ch);
+                return asynError;
+            }
+            seq->channelUsed[ch] = true;
+        }
+
+        for (auto& step : j["steps"]) {
+            if (seq->numSteps >= SEQ_MAX_STEPS) {
+                asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                          "%s::%s too many steps, max %d\n",
+                          driverName, functionName, SEQ_MAX_STEPS);
+                return asynError;
+            }
+            seqStepStruct *setup = &seq->step[seq->numSteps];
+            jstring = step.value("name", "");
+            epicsSnprintf(setup->name, SEQ_NAME_SIZE, "%s", jstring.c_str());
+            setup->channel = step["channel"];
+            //read signed, a negative count must not wrap into a step that never ends
+            scans = step.value("scans", 1);
+            if (setup->channel >= MAX_CHANNELS || !seq->channelUsed[setup->channel] || scans < 1) {
+                asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                          "%s::%s step %u not valid\n",
+                          driverName, functionName, seq->numSteps);
+                return asynError;
+            }
+            setup->scans = scans;
+            seq->numSteps++;
+        }
+    }
+	catch (const json::parse_error& e) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s JSON error parsing string: %s\n", driverName, functionName, e.what());
+        if (fp) fclose(fp);
+        return asynError;
+    }
+    catch (std::exception& e) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s other error parsing string: %s\n", driverName, functionName, e.what());
+        if (fp) fclose(fp);
+        return asynError;
+    }
+
+    if (seq->numSteps == 0)
+        return asynError;
+
+    seq->loaded = true;
+    setIntegerParam(seqSteps_, seq->numSteps);
+    return asynSuccess;
+}
+
+/* Program every recipe channel once and start scanning on the first step */
+asynStatus drvInficon::startSequence()
+{
+    seqStruct *seq = sequence_;
+    char request[HTTP_REQUEST_SIZE];
+    static const char *functionName = "startSequence";
+
+    if (!seq->loaded) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s no sequence loaded\n",
+                  driverName, functionName);
+        return asynError;
+    }
+
+    sprintf(request,"GET /mmsp/scanSetup/scanStop/set?Immediately\r\n"
+                    "\r\n");
+    ioStatus_ = inficonReadWrite(request, data_);
+
+    for (int ch = 1; ch < MAX_CHANNELS; ch++) {
+        const chScanSetupStruct *setup = &seq->channel[ch];
+        if (!seq->channelUsed[ch])
+            continue;
+
+        sprintf(request,"GET /mmsp/scanSetup/channels/%d/set?channelMode=%s&startMass=%.2f&stopMass=%.2f&dwell=%u&ppamu=%u&enabled=True\r\n"
+                        "\r\n",
+                        ch, setup->chMode, setup->chStartMass, setup->chStopMass, setup->chDwell, setup->chPpamu);
+        ioStatus_ = inficonReadWrite(request, data_);
+        if (ioStatus_ != asynSuccess)
+            return ioStatus_;
+
+        //keep the parameter library in step with the device, parseScan builds the mass axis from it
+        setStringParam(ch, chMode_, setup->chMode);
+        setDoubleParam(ch, chStartMass_, setup->chStartMass);
+        setDoubleParam(ch, chStopMass_, setup->chStopMass);
+        setUIntDigitalParam(ch, chDwell_, setup->chDwell, 0xFFFFFFFF);
+        setUIntDigitalParam(ch, chPpamu_, setup->chPpamu, 0xFFFFFFFF);
+    }
+
+    sprintf(request,"GET /mmsp/scanSetup/set?startChannel=%u&stopChannel=%u\r\n"
+                    "\r\n",
+                    seq->step[0].channel, seq->step[0].channel);
+    ioStatus_ = inficonReadWrite(request, data_);
+
+    sprintf(request,"GET /mmsp/scanSetup/scanCount/set?-1\r\n"
+                    "\r\n");
+    ioStatus_ = inficonReadWrite(request, data_);
+
+    sprintf(request,"GET /mmsp/scanSetup/scanStart/set?1\r\n"
+                    "\r\n");
+    inficonReadWrite(request, data_); //scanStart times out before the device answers, same as MONITOR_START
+
+    if (ioStatus_ != asynSuccess)
+        return ioStatus_;
+
+    seq->currStep = 0;
+    seq->prevStep = 0;
+    seq->currCycle = 0;
+    seq->stepFirstScan = -1;
+    setIntegerParam(seqStep_, 0);
+    setStringParam(seqStepName_, seq->step[0].name);
+    setIntegerParam(seqCycle_, 0);
+    return asynSuccess;
+}
+
+/* Move to the next recipe step, only the start/stop channel is sent to the device */
+void drvInficon::advanceSequence()
+{
+    seqStruct *seq = sequence_;
+    char request[HTTP_REQUEST_SIZE];
+    unsigned int prevChannel = seq->step[seq->currStep].channel;
+
+    seq->prevStep = seq->currStep;
+    seq->currStep++;
+    if (seq->currStep >= seq->numSteps) {
+        seq->currStep = 0;
+        seq->currCycle++;
+        if (seq->cycles > 0 && seq->currCycle >= seq->cycles) {
+            //recipe finished, let the scan in progress complete
+            sprintf(request,"GET /mmsp/scanSetup/scanStop/set?EndOfScan\r\n"
+                            "\r\n");
+            ioStatus_ = inficonReadWrite(request, data_);
+            mainState_ = IDLE;
+            setUIntDigitalParam(driverState_, static_cast<unsigned int>(mainState_), 0xF);
+            return;
+        }
+    }
+
+    if (seq->step[seq->currStep].channel != prevChannel) {
+        sprintf(request,"GET /mmsp/scanSetup/set?startChannel=%u&stopChannel=%u\r\n"
+                        "\r\n",
+                        seq->step[seq->currStep].channel, seq->step[seq->currStep].channel);
+        ioStatus_ = inficonReadWrite(request, data_);
+        //the scan in progress still runs on the previous channel
+        seq->stepFirstScan = ((scanInfo_->currScan > scanInfo_->lastScan) ? scanInfo_->currScan : scanInfo_->lastScan) + 1;
+    } else {
+        seq->stepFirstScan = scanInfo_->lastScan + 1;
+    }
+
+    setIntegerParam(seqStep_, seq->currStep);
+    setStringParam(seqStepName_, seq->step[seq->currStep].name);
+    setIntegerParam(seqCycle_, seq->currCycle);
+}
+
+/* Run the analysis stages on a newly parsed spectrum, called by the poller.
+ * The mass axis is corrected first so every later stage sees calibrated masses. */
+void drvInficon::processScan(scanDataStruct *scanData)
+{
+    calibrateMass(scanData);
+    computeScanStats(scanData);
+    analyzePeaks(scanData);
+    detectAnomaly(scanData);
+    integrateMasses(scanData);
+    computeRatios();
+    checkConsistency(scanData);
+    decimateScan(scanData);
+    convertScan(scanData);
+}
+
+/* Integer key that sorts like the float, negative values get their magnitude bits flipped */
+static inline int floatKey(float v)
+{
+    int bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits ^ ((bits >> 31) & 0x7fffffff);
+}
+
+/* Summary statistics of a spectrum. Each quantity gets its own short loop the compiler
+ * vectorizes: the sum is kept in STATS_LANES partial results combined in a fixed order,
+ * the maximum is found on integer keys and then walked back to its first index. */
+void drvInficon::computeScanStats(const scanDataStruct *scanData)
+{
+    scanStatsStruct *st = scanStats_;
+    const float *values = scanData->scanValues;
+    const float threshold = (float)st->threshold;
+    unsigned int n = (scanData->actualScanSize < scanData->scanSize) ? scanData->actualScanSize : scanData->scanSize;
+    unsigned int nBlock, i, k;
+    double sumLane[STATS_LANES];
+    double sum = 0;
+    float max;
+    int keyMax = INT_MIN;
+    int argmax = 0;
+    unsigned int above = 0;
+
+    //the mass axis is filled up to scanSize only
+    if (n > MAX_SCAN_SIZE)
+        n = MAX_SCAN_SIZE;
+    if (n < 2)
+        return;
+
+    for (k = 0; k < STATS_LANES; k++)
+        sumLane[k] = 0;
+    nBlock = n - n % STATS_LANES;
+    for (i = 0; i < nBlock; i += STATS_LANES) {
+        for (k = 0; k < STATS_LANES; k++)
+            sumLane[k] += values[i + k];
+    }
+    for (k = 0; k < STATS_LANES; k++)
+        sum += sumLane[k];
+    for (i = nBlock; i < n; i++)
+        sum += values[i];
+
+    for (i = 0; i < n; i++) {
+        int key = floatKey(values[i]);
+        above += (values[i] > threshold);
+        keyMax = (key > keyMax) ? key : keyMax;
+    }
+    for (int j = (int)n - 1; j >= 0; j--)
+        argmax = (floatKey(values[j]) == keyMax) ? j : argmax;
+    max = values[argmax];
+
+    for (i = 0; i + 1 < n; i++)
+        st->diff[i] = fabsf(values[i + 1] - values[i]);
+
+    //median of |x[i+1]-x[i]| scaled to a gaussian sigma, peaks only move the median slightly
+    std::nth_element(st->diff, st->diff + (n - 1)/2, st->diff + (n - 1));
+    st->noise = st->diff[(n - 1)/2] / (0.6745 * sqrt(2.0));
+
+    st->sum = sum;
+    st->mean = sum / n;
+    st->max = max;
+    st->maxMass = scanData->amuValues[argmax];
+    st->above = above;
+    st->dynRange = (st->noise > 0 && max > 0) ? log10(max / st->noise) : 0;
+
+    setDoubleParam(statsSum_, st->sum);
+    setDoubleParam(statsMean_, st->mean);
+    setDoubleParam(statsMax_, st->max);
+    setDoubleParam(statsMaxMass_, st->maxMass);
+    setDoubleParam(statsNoise_, st->noise);
+    setIntegerParam(statsAbove_, st->above);
+    setDoubleParam(statsDynRange_, st->dynRange);
+}
+
+/* Indices of the minimum and maximum of a bucket, first occurrence on ties. Both passes are
+ * plain min/max and select loops over integer keys, which the compiler vectorizes: the
+ * first finds the extremes, the second walks back to their first index. */
+static void bucketMinMax(const float *values, unsigned int n, unsigned int *iMin, unsigned int *iMax)
+{
+    int keyMin = INT_MAX;
+    int keyMax = INT_MIN;
+    int first = 0;
+    int firstMax = 0;
+    int i, key;
+
+    for (i = 0; i < (int)n; i++) {
+        key = floatKey(values[i]);
+        keyMin = (key < keyMin) ? key : keyMin;
+        keyMax = (key > keyMax) ? key : keyMax;
+    }
+    for (i = (int)n - 1; i >= 0; i--) {
+        key = floatKey(values[i]);
+        first = (key == keyMin) ? i : first;
+        firstMax = (key == keyMax) ? i : firstMax;
+    }
+    *iMin = first;
+    *iMax = firstMax;
+}
+
+/* Reduce the spectrum to DECIM_WIDTH points for displays. Every bucket contributes its
+ * minimum and maximum in the order they occur, so no peak is lost between pixels. */
+void drvInficon::decimateScan(const scanDataStruct *scanData)
+{
+    decimStruct *d = decim_;
+    unsigned int n = (scanData->scanSize < MAX_SCAN_SIZE) ? scanData->scanSize : MAX_SCAN_SIZE;
+    unsigned int buckets, b, start, end, iMin, iMax, first, second;
+
+    if (n <= d->width) {
+        memcpy(d->scanValues, scanData->scanValues, n*sizeof(float));
+        memcpy(d->amuValues, scanData->amuValues, n*sizeof(float));
+        d->size = n;
+        return;
+    }
+
+    buckets = d->width / 2;
+    d->size = 0;
+    for (b = 0; b < buckets; b++) {
+        start = (unsigned int)((unsigned long)b * n / buckets);
+        end = (unsigned int)((unsigned long)(b + 1) * n / buckets);
+        bucketMinMax(scanData->scanValues + start, end - start, &iMin, &iMax);
+        first = start + ((iMin < iMax) ? iMin : iMax);
+        second = start + ((iMin < iMax) ? iMax : iMin);
+        d->scanValues[d->size] = scanData->scanValues[first];
+        d->amuValues[d->size++] = scanData->amuValues[first];
+        d->scanValues[d->size] = scanData->scanValues[second];
+        d->amuValues[d->size++] = scanData->amuValues[second];
+    }
+}
+
+/* Publish the ROIs that are due on this scan. The arrays are handed to the callbacks
+ * as slices of the scan buffer, nothing is copied on the driver side. */
+void drvInficon::publishRois(const scanDataStruct *scanData)
+{
+    unsigned int size = (scanData->scanSize < MAX_SCAN_SIZE) ? scanData->scanSize : MAX_SCAN_SIZE;
+    const float *first, *last;
+
+    for (int i = 1; i <= MAX_ROIS; i++) {
+        roiStruct *roi = &rois_[i];
+
+        if (roi->stopMass < roi->startMass || roi->stopMass <= 0)
+            continue;
+        if (++roi->counter < roi->divider)
+            continue;
+        roi->counter = 0;
+
+        //the mass axis is ascending, so the window is found by bisection
+        first = std::lower_bound(scanData->amuValues, scanData->amuValues + size, (float)roi->startMass);
+        last = std::upper_bound(first, scanData->amuValues + size, (float)roi->stopMass);
+        //a single mass rarely falls exactly on a point, take the nearest one
+        if (roi->stopMass == roi->startMass && size > 0) {
+            if (first == scanData->amuValues + size ||
+                (first > scanData->amuValues && roi->startMass - first[-1] < first[0] - roi->startMass))
+                first--;
+            last = first + 1;
+        }
+        roi->first = first - scanData->amuValues;
+        roi->size = last - first;
+
+        setIntegerParam(i, roiPoints_, roi->size);
+        doCallbacksFloat32Array(const_cast<float*>(scanData->amuValues) + roi->first, roi->size, roiXCoord_, i);
+        doCallbacksFloat32Array(const_cast<float*>(scanData->scanValues) + roi->first, roi->size, roiScan_, i);
+        callParamCallbacks(i);
+    }
+}
+
+/* Load the relative sensitivity table, {"gases": [{"name": "He", "mass": 4, "rsf": 0.14}, ...]}.
+ * Masses not in the table keep the N2 reference sensitivity of 1. */
+asynStatus drvInficon::loadRsfTable(const char *fileName)
+{
+    convStruct *conv = conv_;
+    FILE *fp;
+    static const char *functionName = "loadRsfTable";
+
+    for (int i = 0; i <= CONV_MAX_MASS; i++)
+        conv->rsf[i] = 1.0;
+    conv->rsfCount = 0;
+    conv->scaleValid = false;
+    setIntegerParam(convRsfCount_, 0);
+
+    fp = fopen(fileName, "r");
+    if (fp == NULL) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s can't open %s\n",
+                  driverName, functionName, fileName);
+        return asynError;
+    }
+
+    try {
+        json j = json::parse(fp);
+        unsigned int mass;
+        double rsf;
+
+        fclose(fp);
+        fp = NULL;
+
+        for (auto& gas : j["gases"]) {
+            mass = gas["mass"];
+            rsf = gas["rsf"];
+            if (mass > CONV_MAX_MASS || rsf <= 0) {
+                asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                          "%s::%s entry for mass %u not valid\n",
+                          driverName, functionName, mass);
+                return asynError;
+            }
+            conv->rsf[mass] = rsf;
+            conv->rsfCount++;
+        }
+    }
+	catch (const json::parse_error& e) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s JSON error parsing string: %s\n", driverName, functionName, e.what());
+        if (fp) fclose(fp);
+        return asynError;
+    }
+    catch (std::exception& e) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s other error parsing string: %s\n", driverName, functionName, e.what());
+        if (fp) fclose(fp);
+        return asynError;
+    }
+
+    setIntegerParam(convRsfCount_, conv->rsfCount);
+    return asynSuccess;
+}
+
+/* Convert the ion current spectrum to gas corrected partial pressure in the selected units.
+ * The per point factor unit/(sensitivity*rsf) only changes with the settings or the mass
+ * axis, so it is cached and every scan costs a single multiply pass. */
+void drvInficon::convertScan(const scanDataStruct *scanData)
+{
+    static const double unitScale[] = {1.0, 1.33322368, 133.322368};     /* per Torr */
+    convStruct *conv = conv_;
+    unsigned int n = (scanData->scanSize < MAX_SCAN_SIZE) ? scanData->scanSize : MAX_SCAN_SIZE;
+    double sens = sensIonSource_->ppSensFactor;
+    unsigned int mass;
+
+    conv->size = 0;
+    if (n == 0 || sens <= 0)
+        return;
+
+    if (!conv->scaleValid || conv->scaleSize != n || conv->scaleSens != sens ||
+        conv->scaleFirst != scanData->amuValues[0] || conv->scaleLast != scanData->amuValues[n - 1]) {
+        for (unsigned int i = 0; i < n; i++) {
+            mass = (scanData->amuValues[i] > 0) ? (unsigned int)(scanData->amuValues[i] + 0.5) : 0;
+            if (mass > CONV_MAX_MASS)
+                mass = CONV_MAX_MASS;
+            conv->scale[i] = (float)(unitScale[conv->units] / (sens * conv->rsf[mass]));
+        }
+        conv->scaleSize = n;
+        conv->scaleSens = sens;
+        conv->scaleFirst = scanData->amuValues[0];
+        conv->scaleLast = scanData->amuValues[n - 1];
+        conv->scaleValid = true;
+    }
+
+    for (unsigned int i = 0; i < n; i++)
+        conv->values[i] = scanData->scanValues[i] * conv->scale[i];
+    conv->size = n;
+}
+
+/* Solve the normal equations of a weighted polynomial fit of the given order, 3x3 at most.
+ * Returns false if the system is singular, i.e. not enough distinct reference peaks. */
+static bool fitPolynomial(const double *x, const double *y, const double *w, unsigned int n,
+                          unsigned int order, double *coef)
+{
+    double a[3][4] = {{0}};
+    unsigned int m = order + 1;
+    unsigned int i, r, c, k;
+
+    for (i = 0; i < n; i++) {
+        double p[3] = {1, x[i], x[i]*x[i]};
+        for (r = 0; r < m; r++) {
+            for (c = 0; c < m; c++)
+                a[r][c] += w[i]*p[r]*p[c];
+            a[r][m] += w[i]*p[r]*y[i];
+        }
+    }
+
+    //gaussian elimination with partial pivoting
+    for (c = 0; c < m; c++) {
+        k = c;
+        for (r = c + 1; r < m; r++)
+            if (fabs(a[r][c]) > fabs(a[k][c])) k = r;
+        if (fabs(a[k][c]) < 1e-12)
+            return false;
+        for (r = 0; r <= m; r++)
+            std::swap(a[c][r], a[k][r]);
+        for (r = c + 1; r < m; r++) {
+            double f = a[r][c] / a[c][c];
+            for (k = c; k <= m; k++)
+                a[r][k] -= f*a[c][k];
+        }
+    }
+    for (c = m; c-- > 0;) {
+        double sum = a[c][m];
+        for (k = c + 1; k < m; k++)
+            sum -= a[c][k]*coef[k];
+        coef[c] = sum / a[c][c];
+    }
+    for (c = m; c < 3; c++)
+        coef[c] = 0;
+    return true;
+}
+
+/* Correct the mass axis from the reference peaks. The peaks are centroided on the nominal
+ * axis every scan, which only touches a few points each, and the correction is refitted
+ * only when it misses one of them by more than CAL_THRESHOLD. */
+void drvInficon::calibrateMass(scanDataStruct *scanData)
+{
+    calStruct *cal = cal_;
+    unsigned int n = (scanData->scanSize < MAX_SCAN_SIZE) ? scanData->scanSize : MAX_SCAN_SIZE;
+    float *amu = scanData->amuValues;
+    const float *values = scanData->scanValues;
+    double found[CAL_MAX_REFS], ref[CAL_MAX_REFS], weight[CAL_MAX_REFS];
+    double minPeak = cal->minSnr * scanStats_->noise;
+    double coef[3], drift = 0, residual = 0;
+    unsigned int peaks = 0;
+
+    if (!cal->enable || n < 2)
+        return;
+
+    for (unsigned int r = 0; r < cal->numRefs; r++) {
+        float *lo = std::lower_bound(amu, amu + n, (float)(cal->refMass[r] - CAL_WINDOW));
+        float *hi = std::upper_bound(lo, amu + n, (float)(cal->refMass[r] + CAL_WINDOW));
+        unsigned int first = lo - amu, last = hi - amu, top, i;
+        double sum = 0, sumX = 0;
+
+        if (first >= last)
+            continue;
+        top = first;
+        for (i = first; i < last; i++)
+            if (values[i] > values[top]) top = i;
+        if (values[top] <= minPeak || values[top] <= 0)
+            continue;
+
+        //centroid of the points above half height around the top
+        for (i = top; i > first && values[i - 1] > values[top]/2; i--);
+        for (; i < last && values[i] > values[top]/2; i++) {
+            sum += values[i];
+            sumX += values[i]*amu[i];
+        }
+        found[peaks] = sumX / sum;
+        ref[peaks] = cal->refMass[r];
+        weight[peaks] = 1.0;
+        peaks++;
+    }
+
+    for (unsigned int p = 0; p < peaks; p++) {
+        double err = fabs(cal->coef[0] + found[p]*(cal->coef[1] + found[p]*cal->coef[2]) - ref[p]);
+        if (err > drift) drift = err;
+    }
+
+    if (drift > cal->threshold && peaks > cal->order &&
+        fitPolynomial(found, ref, weight, peaks, cal->order, coef)) {
+        for (unsigned int p = 0; p < peaks; p++) {
+            double err = coef[0] + found[p]*(coef[1] + found[p]*coef[2]) - ref[p];
+            residual += err*err;
+        }
+        cal->residual = sqrt(residual / peaks);
+        for (int c = 0; c < 3; c++)
+            cal->coef[c] = coef[c];
+        cal->fits++;
+        setDoubleParam(calC0_, cal->coef[0]);
+        setDoubleParam(calC1_, cal->coef[1]);
+        setDoubleParam(calC2_, cal->coef[2]);
+        setDoubleParam(calResidual_, cal->residual);
+        setIntegerParam(calFits_, cal->fits);
+    }
+    setIntegerParam(calPeaks_, peaks);
+    setDoubleParam(calDrift_, drift);
+
+    for (unsigned int i = 0; i < n; i++) {
+        double x = amu[i];
+        amu[i] = (float)(cal->coef[0] + x*(cal->coef[1] + x*cal->coef[2]));
+    }
+}
+
+/* Back to the nominal axis, the next scan with enough peaks refits */
+void drvInficon::resetMassCal()
+{
+    cal_->coef[0] = 0;
+    cal_->coef[1] = 1;
+    cal_->coef[2] = 0;
+    cal_->residual = 0;
+    setDoubleParam(calC0_, cal_->coef[0]);
+    setDoubleParam(calC1_, cal_->coef[1]);
+    setDoubleParam(calC2_, cal_->coef[2]);
+    setDoubleParam(calResidual_, 0);
+}
+
+/* Fit the peak at index top with a gaussian and measure its half height widths.
+ * The fit is a weighted parabola through the log of the points above half height,
+ * closed form and limited to PEAK_FIT_POINTS, so the cost per peak is bounded. */
+static void fitPeakShape(const float *amu, const float *values, unsigned int n, unsigned int top,
+                         float *mass, float *fwhm, float *asym)
+{
+    double x[PEAK_FIT_POINTS], y[PEAK_FIT_POINTS], w[PEAK_FIT_POINTS], coef[3];
+    double height = values[top], half = height/2;
+    double left, right;
+    unsigned int lo = top, hi = top, points = 0;
+
+    while (lo > 0 && top - lo < PEAK_FIT_POINTS/2 && values[lo - 1] > half) lo--;
+    while (hi + 1 < n && hi - top < PEAK_FIT_POINTS/2 && values[hi + 1] > half) hi++;
+
+    //interpolated half height crossings, the last point above half if the edge is not reached
+    left = amu[lo];
+    if (lo > 0 && values[lo - 1] <= half)
+        left = amu[lo - 1] + (amu[lo] - amu[lo - 1]) * (half - values[lo - 1]) / (values[lo] - values[lo - 1]);
+    right = amu[hi];
+    if (hi + 1 < n && values[hi + 1] <= half)
+        right = amu[hi] + (amu[hi + 1] - amu[hi]) * (values[hi] - half) / (values[hi] - values[hi + 1]);
+
+    *mass = amu[top];
+    *fwhm = (float)(right - left);
+    *asym = (amu[top] - left > 0) ? (float)((right - amu[top]) / (amu[top] - left)) : 0;
+
+    for (unsigned int i = lo; i <= hi && points < PEAK_FIT_POINTS; i++) {
+        double r = values[i] / height;
+        x[points] = amu[i] - amu[top];
+        y[points] = log(r);
+        w[points] = r*r;
+        points++;
+    }
+    //ln(y) = c0 + c1*x + c2*x^2, sigma^2 = -1/(2*c2)
+    if (points >= 3 && fitPolynomial(x, y, w, points, 2, coef) && coef[2] < 0) {
+        *mass = (float)(amu[top] - coef[1]/(2*coef[2]));
+        *fwhm = (float)(2*sqrt(log(2.0)) * sqrt(-1/coef[2]));
+    }
+}
+
+/* Shape of the largest peaks on every PEAK_DIVIDER-th scan, with a trend of the mean
+ * width and resolution. Only fixed size buffers are used so it can run at scan rate. */
+void drvInficon::analyzePeaks(const scanDataStruct *scanData)
+{
+    peakStruct *pk = peaks_;
+    unsigned int n = (scanData->scanSize < MAX_SCAN_SIZE) ? scanData->scanSize : MAX_SCAN_SIZE;
+    const float *values = scanData->scanValues;
+    const float *amu = scanData->amuValues;
+    double minPeak = pk->minSnr * scanStats_->noise;
+    double sumFwhm = 0, sumRes = 0;
+    unsigned int found = 0, j, idx;
+
+    if (pk->divider == 0 || n < 3)
+        return;
+    if (++pk->counter < pk->divider)
+        return;
+    pk->counter = 0;
+
+    //keep the numPeaks largest local maxima, at most one per PEAK_SEPARATION
+    for (unsigned int i = 1; i + 1 < n; i++) {
+        float v = values[i];
+        if (v <= minPeak || v <= 0 || v < values[i - 1] || v < values[i + 1])
+            continue;
+        if (found == pk->numPeaks && v <= values[pk->top[found - 1]])
+            continue;
+        for (j = 0; j < found; j++)
+            if (fabs(amu[pk->top[j]] - amu[i]) < PEAK_SEPARATION) break;
+        if (j < found) {
+            if (v <= values[pk->top[j]])
+                continue;
+            for (; j + 1 < found; j++)
+                pk->top[j] = pk->top[j + 1];
+            found--;
+        }
+        for (j = (found < pk->numPeaks) ? found++ : found - 1; j > 0 && values[pk->top[j - 1]] < v; j--)
+            pk->top[j] = pk->top[j - 1];
+        pk->top[j] = i;
+    }
+
+    for (j = 0; j < found; j++) {
+        fitPeakShape(amu, values, n, pk->top[j], &pk->mass[j], &pk->fwhm[j], &pk->asym[j]);
+        pk->resolution[j] = (pk->fwhm[j] > 0) ? pk->mass[j] / pk->fwhm[j] : 0;
+        sumFwhm += pk->fwhm[j];
+        sumRes += pk->resolution[j];
+    }
+    pk->found = found;
+
+    if (found > 0) {
+        pk->trendFwhm[pk->head] = (float)(sumFwhm / found);
+        pk->trendRes[pk->head] = (float)(sumRes / found);
+        pk->head = (pk->head + 1) % PEAK_TREND_SIZE;
+        if (pk->count < PEAK_TREND_SIZE)
+            pk->count++;
+    }
+    //copy the trend in chronological order
+    for (unsigned int i = 0; i < pk->count; i++) {
+        idx = (pk->head + PEAK_TREND_SIZE - pk->count + i) % PEAK_TREND_SIZE;
+        pk->histFwhm[i] = pk->trendFwhm[idx];
+        pk->histRes[i] = pk->trendRes[idx];
+    }
+
+    setIntegerParam(peakFound_, found);
+    setDoubleParam(peakFwhmMean_, (found > 0) ? sumFwhm / found : 0);
+    setDoubleParam(peakResMean_, (found > 0) ? sumRes / found : 0);
+    queueArray(pk->mass, found, peakMass_, 0);
+    queueArray(pk->fwhm, found, peakFwhm_, 0);
+    queueArray(pk->asym, found, peakAsym_, 0);
+    queueArray(pk->resolution, found, peakRes_, 0);
+    queueArray(pk->histFwhm, pk->count, peakTrendFwhm_, 0);
+    queueArray(pk->histRes, pk->count, peakTrendRes_, 0);
+}
+
+/* Score a scan against the learned reference, an exponentially weighted mean and variance
+ * per point. The score is the mean squared deviation in units of the per point sigma, with
+ * the scan noise as a floor so flat baseline points don't blow up. The reference only
+ * learns from scans that are not in alarm, so a slow leak can't become the new normal. A
+ * lasting change (a vent, a new gas) is taken as the new normal after ANOM_RELEARN alarmed
+ * scans in a row, if set. */
+void drvInficon::detectAnomaly(const scanDataStruct *scanData)
+{
+    anomStruct *an = anomaly_;
+    unsigned int n = (scanData->scanSize < MAX_SCAN_SIZE) ? scanData->scanSize : MAX_SCAN_SIZE;
+    const float *values = scanData->scanValues;
+    const float *amu = scanData->amuValues;
+    const float alpha = (float)an->alpha;
+    float floor = (float)(scanStats_->noise * scanStats_->noise);
+    float sumLane[STATS_LANES];
+    unsigned int nBlock = n - n % STATS_LANES;
+    unsigned int i, k, j, found = 0;
+    double score = 0;
+    bool alarm;
+
+    if (!an->enable || n == 0)
+        return;
+
+    //start learning again when the scan setup changes, the calibrated axis may move on its own
+    if (an->count == 0 || an->size != n || an->startMass != scanData->startMass ||
+        an->stopMass != scanData->stopMass || an->ppamu != scanData->ppamu) {
+        memcpy(an->mean, values, n*sizeof(float));
+        memset(an->var, 0, n*sizeof(float));
+        an->size = n;
+        an->startMass = scanData->startMass;
+        an->stopMass = scanData->stopMass;
+        an->ppamu = scanData->ppamu;
+        an->count = 1;
+        an->alarmed = 0;
+        setIntegerParam(anomCount_, an->count);
+        return;
+    }
+    if (floor < FLT_MIN)
+        floor = FLT_MIN;
+
+    for (k = 0; k < STATS_LANES; k++)
+        sumLane[k] = 0;
+    for (i = 0; i < nBlock; i += STATS_LANES) {
+        for (k = 0; k < STATS_LANES; k++) {
+            float d = values[i + k] - an->mean[i + k];
+            float z = d*d / (an->var[i + k] + floor);
+            an->z[i + k] = z;
+            sumLane[k] += z;
+        }
+    }
+    for (; i < n; i++) {
+        float d = values[i] - an->mean[i];
+        an->z[i] = d*d / (an->var[i] + floor);
+        score += an->z[i];
+    }
+    for (k = 0; k < STATS_LANES; k++)
+        score += sumLane[k];
+    score /= n;
+
+    //largest contributions, largest first
+    for (i = 0; i < n; i++) {
+        float z = an->z[i];
+        if (found == ANOM_TOP && z <= an->topScore[found - 1])
+            continue;
+        for (j = (found < ANOM_TOP) ? found++ : found - 1; j > 0 && an->topScore[j - 1] < z; j--) {
+            an->topScore[j] = an->topScore[j - 1];
+            an->topMass[j] = an->topMass[j - 1];
+        }
+        an->topScore[j] = z;
+        an->topMass[j] = amu[i];
+    }
+
+    alarm = (an->count >= an->warmup && score > an->threshold);
+    if (!alarm) {
+        for (i = 0; i < n; i++) {
+            float d = values[i] - an->mean[i];
+            an->mean[i] += alpha*d;
+            an->var[i] = (1 - alpha)*(an->var[i] + alpha*d*d);
+        }
+        an->count++;
+        an->alarmed = 0;
+    } else if (an->relearn > 0 && ++an->alarmed >= an->relearn) {
+        //the change has lasted, learn it from the next scan on
+        an->count = 0;
+        an->alarmed = 0;
+    }
+
+    setDoubleParam(anomScore_, score);
+    setIntegerParam(anomAlarm_, alarm);
+    setIntegerParam(anomCount_, an->count);
+    queueArray(an->topMass, found, anomTopMass_, 0);
+    queueArray(an->topScore, found, anomTopScore_, 0);
+    queueArray(an->mean, n, anomRef_, 0);
+}
+
+/* Integrate the spectrum into one bin per nominal mass, points within RATIO_WIDTH of the
+ * integer mass count towards it. The numerator and denominator windows of the ratio entries
+ * are summed in the same pass, they may be narrower or wider than the bins and overlap. */
+void drvInficon::integrateMasses(const scanDataStruct *scanData)
+{
+    ratioStruct *rt = ratios_;
+    unsigned int n = (scanData->scanSize < MAX_SCAN_SIZE) ? scanData->scanSize : MAX_SCAN_SIZE;
+    const float *values = scanData->scanValues;
+    const float *amu = scanData->amuValues;
+    const float width = (float)rt->width;
+    int mass;
+
+    memset(rt->integral, 0, sizeof(rt->integral));
+    rt->maxMass = 0;
+    for (int k = 1; k <= RATIO_MAX; k++) {
+        rt->entry[k].numSum = 0;
+        rt->entry[k].denSum = 0;
+    }
+    for (unsigned int i = 0; i < n; i++) {
+        for (int k = 1; k <= RATIO_MAX; k++) {
+            ratioEntryStruct *r = &rt->entry[k];
+            if (fabs(amu[i] - r->numMass) <= r->numWidth)
+                r->numSum += values[i];
+            if (fabs(amu[i] - r->denMass) <= r->denWidth)
+                r->denSum += values[i];
+        }
+        mass = (int)(amu[i] + 0.5f);
+        if (mass < 0 || mass > CONV_MAX_MASS || fabsf(amu[i] - mass) > width)
+            continue;
+        rt->integral[mass] += values[i];
+        if ((unsigned int)mass > rt->maxMass)
+            rt->maxMass = mass;
+    }
+}
+
+/* Ratios of the mass integrals, their rolling statistics and the leak and water indicators */
+void drvInficon::computeRatios()
+{
+    ratioStruct *rt = ratios_;
+    const float *integral = rt->integral;
+    const ratioEntryStruct *e;
+    double mean, var, value;
+    unsigned int count, idx, largest = 0;
+    int air, water;
+
+    for (int i = 1; i <= RATIO_MAX; i++) {
+        ratioEntryStruct *r = &rt->entry[i];
+
+        if (r->denSum <= 0)
+            continue;
+        r->hist[r->head] = r->numSum / r->denSum;
+        r->head = (r->head + 1) % RATIO_HIST_SIZE;
+        if (r->count < RATIO_HIST_SIZE)
+            r->count++;
+
+        count = (r->count < rt->window) ? r->count : rt->window;
+        mean = 0;
+        for (unsigned int j = 0; j < count; j++)
+            mean += r->hist[(r->head + RATIO_HIST_SIZE - 1 - j) % RATIO_HIST_SIZE];
+        mean /= count;
+        var = 0;
+        for (unsigned int j = 0; j < count; j++) {
+            idx = (r->head + RATIO_HIST_SIZE - 1 - j) % RATIO_HIST_SIZE;
+            var += (r->hist[idx] - mean)*(r->hist[idx] - mean);
+        }
+        value = r->hist[(r->head + RATIO_HIST_SIZE - 1) % RATIO_HIST_SIZE];
+
+        setDoubleParam(i, ratioValue_, value);
+        setDoubleParam(i, ratioMean_, mean);
+        setDoubleParam(i, ratioStd_, (count > 1) ? sqrt(var / (count - 1)) : 0);
+    }
+
+    //air gives N2/O2 near 4, the band widens by RATIO_HYST once the indicator is set
+    e = &rt->entry[rt->airEntry];
+    air = rt->airLeak;
+    if (e->numSum > 0 && e->denSum > 0) {
+        value = e->numSum / e->denSum;
+        if (!air && value >= rt->airLow && value <= rt->airHigh)
+            air = 1;
+        else if (air && (value < rt->airLow*(1 - RATIO_HYST) || value > rt->airHigh*(1 + RATIO_HYST)))
+            air = 0;
+    } else {
+        air = 0;
+    }
+
+    //water needs its cracking signature and its parent mass the largest bin
+    e = &rt->entry[rt->waterEntry];
+    for (unsigned int m = 1; m <= rt->maxMass; m++)
+        if (integral[m] > integral[largest])
+            largest = m;
+    water = rt->waterDominated;
+    value = (e->denSum > 0) ? e->numSum / e->denSum : ((e->numSum > 0) ? rt->waterOn : 0);
+    if (integral[largest] <= 0 || (int)largest != e->numMass)
+        water = 0;
+    else if (!water && value >= rt->waterOn)
+        water = 1;
+    else if (water && value < rt->waterOff)
+        water = 0;
+
+    rt->airLeak = air;
+    rt->waterDominated = water;
+    setIntegerParam(airLeak_, air);
+    setIntegerParam(waterDominated_, water);
+    queueArray(rt->mass, rt->maxMass + 1, massIntegralMass_, 0);
+    queueArray(rt->integral, rt->maxMass + 1, massIntegral_, 0);
+}
+
+/* Compare the partial pressure summed over the mass bins with the total pressure sampled
+ * while the scan ran. A healthy detector keeps the ratio constant, so the slope of its log
+ * over the trend buffer is a drift rate that warns of EM gain loss or a weak filament. */
+void drvInficon::checkConsistency(const scanDataStruct *scanData)
+{
+    consStruct *cs = consistency_;
+    pressHistStruct *hist = pressHistory_;
+    const ratioStruct *rt = ratios_;
+    double sens = sensIonSource_->ppSensFactor;
+    double now, partial = 0, total = 0, dAMU, ratio;
+    double sumT = 0, sumY = 0, sumTT = 0, sumTY = 0, t, y, drift = 0;
+    unsigned int samples = 0, idx;
+    epicsTimeStamp stamp;
+
+    if (sens <= 0 || scanData->scanSize < 2 || hist->count == 0)
+        return;
+
+    //total pressure averaged over the samples taken since the previous scan
+    for (unsigned int i = 0; i < hist->count; i++) {
+        idx = (hist->head + PRESS_HIST_SIZE - 1 - i) % PRESS_HIST_SIZE;
+        if (i > 0 && hist->sampleTime[idx] <= cs->lastTime)
+            break;
+        total += hist->sampleValue[idx];
+        samples++;
+    }
+    cs->lastTime = hist->sampleTime[(hist->head + PRESS_HIST_SIZE - 1) % PRESS_HIST_SIZE];
+    total /= samples;
+    if (total <= 0)
+        return;
+
+    //peak areas in amu from the shared mass bins
+    dAMU = scanData->amuValues[1] - scanData->amuValues[0];
+    for (unsigned int m = 0; m <= rt->maxMass; m++)
+        partial += rt->integral[m] / conv_->rsf[m];
+    partial *= dAMU / sens;
+    if (partial <= 0)
+        return;
+    ratio = partial / total;
+
+    epicsTimeGetCurrent(&stamp);
+    now = stamp.secPastEpoch + stamp.nsec * 1e-9;
+    cs->time[cs->head] = now;
+    cs->ratio[cs->head] = (float)ratio;
+    cs->head = (cs->head + 1) % CONS_HIST_SIZE;
+    if (cs->count < CONS_HIST_SIZE)
+        cs->count++;
+
+    //least squares slope of ln(ratio) against hours, relative to the newest point
+    for (unsigned int i = 0; i < cs->count; i++) {
+        idx = (cs->head + CONS_HIST_SIZE - cs->count + i) % CONS_HIST_SIZE;
+        t = (cs->time[idx] - now) / 3600.0;
+        y = log(cs->ratio[idx]);
+        sumT += t;
+        sumY += y;
+        sumTT += t*t;
+        sumTY += t*y;
+        cs->histRatio[i] = cs->ratio[idx];
+    }
+    if (cs->count >= CONS_MIN_SAMPLES && cs->count*sumTT - sumT*sumT > 0)
+        drift = 100.0 * (cs->count*sumTY - sumT*sumY) / (cs->count*sumTT - sumT*sumT);
+
+    setDoubleParam(consRatio_, ratio);
+    setDoubleParam(consDrift_, drift);
+    setIntegerParam(consAlarm_, cs->driftLimit > 0 && fabs(drift) > cs->driftLimit);
+    queueArray(cs->histRatio, cs->count, consTrend_, 0);
+}
+
+/* Switch to a single mass measurement at the gain mass and start with the Faraday reading */
+asynStatus drvInficon::startEmCal()
+{
+    emCalStruct *ec = emCal_;
+    char request[HTTP_REQUEST_SIZE];
+    static const char *functionName = "startEmCal";
+
+    if (sensDetect_->emVMax <= sensDetect_->emVMin || sensDetect_->emGainMass == 0) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s EM limits not read from the device yet\n",
+                  driverName, functionName);
+        return asynError;
+    }
+
+    //channel 4, the scanned channels and the EM are borrowed, read them back to restore at the end
+    sprintf(request,"GET /mmsp/scanSetup/channel/4/get\r\n"
+                    "\r\n");
+    ioStatus_ = inficonReadWrite(request, data_);
+    if (ioStatus_ == asynSuccess)
+        ioStatus_ = parseChScanSetup(data_, chScanSetup_, 4);
+    if (ioStatus_ != asynSuccess)
+        return ioStatus_;
+    ec->savedSetup = chScanSetup_[4];
+
+    sprintf(request,"GET /mmsp/scanSetup/get\r\n"
+                    "\r\n");
+    ioStatus_ = inficonReadWrite(request, data_);
+    if (ioStatus_ == asynSuccess)
+        ioStatus_ = parseScanChannels(data_, &ec->savedStartChannel, &ec->savedStopChannel);
+    if (ioStatus_ != asynSuccess)
+        return ioStatus_;
+
+    sprintf(request,"GET /mmsp/generalControl/get\r\n"
+                    "\r\n");
+    ioStatus_ = inficonReadWrite(request, data_);
+    if (ioStatus_ == asynSuccess)
+        ioStatus_ = parseEmState(data_, &ec->savedEmOn);
+    if (ioStatus_ != asynSuccess)
+        return ioStatus_;
+
+    ec->mass = sensDetect_->emGainMass;
+    ec->vMin = sensDetect_->emVMin;
+    ec->vMax = sensDetect_->emVMax;
+    ec->voltage = sensDetect_->emV;
+    ec->savedVoltage = sensDetect_->emV;
+
+    sprintf(request,"GET /mmsp/scanSetup/scanStop/set?Immediately\r\n"
+                    "\r\n");
+    ioStatus_ = inficonReadWrite(request, data_);
+
+    sprintf(request,"GET /mmsp/scanSetup/channels/4/set?channelMode=Single&startMass=%u&stopMass=%u&enabled=True\r\n"
+                    "\r\n",
+                    ec->mass, ec->mass);
+    ioStatus_ = inficonReadWrite(request, data_);
+
+    sprintf(request,"GET /mmsp/scanSetup/set?startChannel=4&stopChannel=4\r\n"
+                    "\r\n");
+    ioStatus_ = inficonReadWrite(request, data_);
+
+    sprintf(request,"GET /mmsp/scanSetup/scanCount/set?-1\r\n"
+                    "\r\n");
+    ioStatus_ = inficonReadWrite(request, data_);
+
+    sprintf(request,"GET /mmsp/generalControl/setEM/set?0\r\n"
+                    "\r\n");
+    ioStatus_ = inficonReadWrite(request, data_);
+
+    sprintf(request,"GET /mmsp/scanSetup/scanStart/set?1\r\n"
+                    "\r\n");
+    //same as the leakcheck start, scanStart times out before the device answers
+    inficonReadWrite(request, data_);
+
+    if (ioStatus_ != asynSuccess)
+        return ioStatus_;
+
+    ec->phase = EMCAL_FARADAY;
+    ec->iteration = 0;
+    ec->haveLow = false;
+    ec->haveHigh = false;
+    ec->havePrev = false;
+    ec->sum = 0;
+    ec->readings = 0;
+    ec->settleScan = -1;
+    lastPolledScan_ = -1;
+    setIntegerParam(emCalPhase_, ec->phase);
+    setIntegerParam(emCalIter_, 0);
+    return asynSuccess;
+}
+
+/* Move the EM to a new voltage, readings are taken once a full scan ran at it */
+void drvInficon::setEmCalVoltage(unsigned int voltage)
+{
+    emCalStruct *ec = emCal_;
+    char request[HTTP_REQUEST_SIZE];
+
+    ec->voltage = voltage;
+    sprintf(request,"GET /mmsp/sensorDetector/emVoltage/set?%u\r\n"
+                    "\r\n",
+                    voltage);
+    ioStatus_ = inficonReadWrite(request, data_);
+    ec->settleScan = scanInfo_->currScan;
+    ec->sum = 0;
+    ec->readings = 0;
+    setIntegerParam(emCalVoltage_, voltage);
+}
+
+/* Take one single mass reading. Once EMCAL_SCANS readings are averaged the next
+ * voltage is chosen: log(gain) is close to linear in the EM voltage, so a secant
+ * step on it converges in a few scans, with bisection of the bracket as fallback. */
+void drvInficon::emCalReading(int scanNumber, double value)
+{
+    emCalStruct *ec = emCal_;
+    char request[HTTP_REQUEST_SIZE];
+    double reading, gain, err, next;
+    unsigned int voltage;
+
+    //skip the scan that was running when the setting changed
+    if (scanNumber <= ec->settleScan)
+        return;
+    ec->sum += value;
+    if (++ec->readings < ec->scans)
+        return;
+    reading = ec->sum / ec->readings;
+
+    if (ec->phase == EMCAL_FARADAY) {
+        if (reading <= 0) {
+            finishEmCal(EMCAL_FAILED);
+            return;
+        }
+        ec->faraday = reading;
+        setDoubleParam(emCalFaraday_, reading);
+        sprintf(request,"GET /mmsp/generalControl/setEM/set?1\r\n"
+                        "\r\n");
+        ioStatus_ = inficonReadWrite(request, data_);
+        ec->phase = EMCAL_SEARCH;
+        setIntegerParam(emCalPhase_, ec->phase);
+        setEmCalVoltage(ec->voltage);
+        return;
+    }
+
+    gain = reading / ec->faraday;
+    ec->gain = gain;
+    ec->iteration++;
+    setDoubleParam(emCalGain_, gain);
+    setIntegerParam(emCalIter_, ec->iteration);
+    if (gain <= 0) {
+        finishEmCal(EMCAL_FAILED);
+        return;
+    }
+
+    err = log(gain / ec->target);
+    if (fabs(err) <= log(1 + ec->tolerance/100.0)) {
+        finishEmCal(EMCAL_DONE);
+        return;
+    }
+    if (ec->iteration >= EMCAL_MAX_ITER) {
+        finishEmCal(EMCAL_FAILED);
+        return;
+    }
+
+    if (err < 0) {
+        ec->haveLow = true;
+        ec->vLow = ec->voltage;
+        ec->errLow = err;
+        ec->gainLow = gain;
+    } else {
+        ec->haveHigh = true;
+        ec->vHigh = ec->voltage;
+        ec->errHigh = err;
+        ec->gainHigh = gain;
+    }
+
+    //secant through the last two points, the default slope before there are two
+    if (ec->havePrev && ec->voltage != ec->vPrev && err != ec->errPrev)
+        next = ec->voltage - err * (ec->voltage - ec->vPrev) / (err - ec->errPrev);
+    else
+        next = ec->voltage - err / EMCAL_LOG_SLOPE;
+    if (ec->haveLow && ec->haveHigh) {
+        if (ec->vHigh - ec->vLow <= 1) {
+            //the voltage resolution is reached, keep the closer end with the gain read there
+            if (fabs(ec->errLow) < fabs(ec->errHigh)) {
+                ec->voltage = ec->vLow;
+                ec->gain = ec->gainLow;
+            } else {
+                ec->voltage = ec->vHigh;
+                ec->gain = ec->gainHigh;
+            }
+            setIntegerParam(emCalVoltage_, ec->voltage);
+            setDoubleParam(emCalGain_, ec->gain);
+            finishEmCal(EMCAL_DONE);
+            return;
+        }
+        if (next <= ec->vLow || next >= ec->vHigh)
+            next = (ec->vLow + ec->vHigh) / 2.0;
+    }
+    if (next < ec->vMin) next = ec->vMin;
+    if (next > ec->vMax) next = ec->vMax;
+    voltage = (unsigned int)(next + 0.5);
+
+    //the target can't be reached inside the EM voltage limits
+    if (voltage == ec->voltage) {
+        finishEmCal(EMCAL_FAILED);
+        return;
+    }
+
+    ec->vPrev = ec->voltage;
+    ec->errPrev = err;
+    ec->havePrev = true;
+    setEmCalVoltage(voltage);
+}
+
+/* Stop scanning, store a successful result in the device in one request, otherwise
+ * put the previous voltage back, and give the EM state and the scan setup back */
+void drvInficon::finishEmCal(emCalPhase_t result)
+{
+    emCalStruct *ec = emCal_;
+    char request[HTTP_REQUEST_SIZE];
+
+    sprintf(request,"GET /mmsp/scanSetup/scanStop/set?Immediately\r\n"
+                    "\r\n");
+    ioStatus_ = inficonReadWrite(request, data_);
+
+    if (result == EMCAL_DONE) {
+        sprintf(request,"GET /mmsp/sensorDetector/set?emVoltage=%u&emGain=%.2f\r\n"
+                        "\r\n",
+                        ec->voltage, ec->gain);
+        ioStatus_ = inficonReadWrite(request, data_);
+    } else {
+        sprintf(request,"GET /mmsp/sensorDetector/emVoltage/set?%u\r\n"
+                        "\r\n",
+                        ec->savedVoltage);
+        ioStatus_ = inficonReadWrite(request, data_);
+    }
+
+    sprintf(request,"GET /mmsp/generalControl/setEM/set?%u\r\n"
+                    "\r\n",
+                    ec->savedEmOn);
+    ioStatus_ = inficonReadWrite(request, data_);
+
+    sprintf(request,"GET /mmsp/scanSetup/channels/4/set?channelMode=%s&startMass=%.2f&stopMass=%.2f&enabled=%s\r\n"
+                    "\r\n",
+                    ec->savedSetup.chMode, ec->savedSetup.chStartMass, ec->savedSetup.chStopMass,
+                    ec->savedSetup.chEnabled ? "True" : "False");
+    ioStatus_ = inficonReadWrite(request, data_);
+
+    sprintf(request,"GET /mmsp/scanSetup/set?startChannel=%u&stopChannel=%u\r\n"
+                    "\r\n",
+                    ec->savedStartChannel, ec->savedStopChannel);
+    ioStatus_ = inficonReadWrite(request, data_);
+
+    ec->phase = result;
+    setIntegerParam(emCalPhase_, ec->phase);
+    mainState_ = IDLE;
+    setUIntDigitalParam(driverState_, static_cast<unsigned int>(mainState_), 0xF);
+}
+
+/* Open the lifetime store and load its records, a new file gets an empty ring header */
+asynStatus drvInficon::openLifeStore(const char *fileName)
+{
+    lifeStruct *lf = life_;
+    lifeFileHeaderStruct header;
+    FILE *fp;
+    static const char *functionName = "openLifeStore";
+
+    lf->count = 0;
+    lf->head = 0;
+    lf->fileName[0] = '\0';
+
+    fp = fopen(fileName, "rb");
+    if (fp != NULL) {
+        if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, LIFE_MAGIC, 4) != 0 ||
+            header.version != LIFE_VERSION || header.recordSize != sizeof(lifeRecordStruct) ||
+            header.capacity != LIFE_SIZE || header.head >= LIFE_SIZE || header.count > LIFE_SIZE) {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                      "%s::%s %s is not a lifetime store of this version\n",
+                      driverName, functionName, fileName);
+            fclose(fp);
+            return asynError;
+        }
+        //slots are filled from 0, the ring only wraps once all of them are in use
+        if (fread(lf->record, sizeof(lifeRecordStruct), header.count, fp) != header.count) {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                      "%s::%s %s is truncated\n",
+                      driverName, functionName, fileName);
+            fclose(fp);
+            return asynError;
+        }
+        lf->head = header.head;
+        lf->count = header.count;
+        fclose(fp);
+    } else {
+        fp = fopen(fileName, "wb");
+        if (fp == NULL) {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                      "%s::%s can't create %s\n",
+                      driverName, functionName, fileName);
+            return asynError;
+        }
+        memcpy(header.magic, LIFE_MAGIC, 4);
+        header.version = LIFE_VERSION;
+        header.recordSize = sizeof(lifeRecordStruct);
+        header.capacity = LIFE_SIZE;
+        header.head = 0;
+        header.count = 0;
+        fwrite(&header, sizeof(header), 1, fp);
+        fclose(fp);
+    }
+
+    strcpy(lf->fileName, fileName);
+    setIntegerParam(lifeSamples_, lf->count);
+    estimateLife();
+    return asynSuccess;
+}
+
+/* Average the diagnostic readings, called with every parsed diagnostic sample. Once per
+ * LIFE_PERIOD the averages and the status counters are stored as one record, in the
+ * same ring slot of the file as in memory. */
+void drvInficon::lifeAccumulate()
+{
+    lifeStruct *lf = life_;
+    lifeRecordStruct *rec;
+    lifeFileHeaderStruct header;
+    epicsTimeStamp now;
+    unsigned int slot;
+    FILE *fp;
+
+    //the filament current is 0 with the emission off, that says nothing about wear
+    if (diagData_->filCurrent > 0) {
+        lf->sumEmi += diagData_->emiCurrent;
+        lf->sumFil += diagData_->filCurrent;
+        lf->sumTemp += diagData_->boxTemp;
+        lf->samples++;
+    }
+
+    epicsTimeGetCurrent(&now);
+    if (lf->periodStart == 0)
+        lf->periodStart = now.secPastEpoch;
+    if (now.secPastEpoch - lf->periodStart < lf->period || lf->samples == 0)
+        return;
+
+    slot = lf->head;
+    rec = &lf->record[slot];
+    rec->time = now.secPastEpoch;
+    rec->filSel = sensIonSource_->filSel;
+    rec->emHours = (float)devStatus_->emCmlOnTime;
+    rec->filHours[0] = (float)devStatus_->filament[1].emiCmlOnTime;
+    rec->filHours[1] = (float)devStatus_->filament[2].emiCmlOnTime;
+    rec->emPressTrip = devStatus_->emPressTrip;
+    rec->filPressTrip[0] = devStatus_->filament[1].emiPressTrip;
+    rec->filPressTrip[1] = devStatus_->filament[2].emiPressTrip;
+    rec->emV = sensDetect_->emV;
+    rec->emGain = (float)sensDetect_->emGain;
+    rec->emiCurrent = (float)(lf->sumEmi / lf->samples);
+    rec->filCurrent = (float)(lf->sumFil / lf->samples);
+    rec->boxTemp = (float)(lf->sumTemp / lf->samples);
+    lf->head = (lf->head + 1) % LIFE_SIZE;
+    if (lf->count < LIFE_SIZE)
+        lf->count++;
+
+    lf->periodStart = now.secPastEpoch;
+    lf->sumEmi = lf->sumFil = lf->sumTemp = 0;
+    lf->samples = 0;
+
+    //the record goes in before the header moves on, a crash in between only loses it
+    if (lf->fileName[0] != '\0') {
+        fp = fopen(lf->fileName, "r+b");
+        if (fp != NULL) {
+            memcpy(header.magic, LIFE_MAGIC, 4);
+            header.version = LIFE_VERSION;
+            header.recordSize = sizeof(lifeRecordStruct);
+            header.capacity = LIFE_SIZE;
+            header.head = lf->head;
+            header.count = lf->count;
+            if (fseek(fp, sizeof(header) + slot*sizeof(*rec), SEEK_SET) == 0 &&
+                fwrite(rec, sizeof(*rec), 1, fp) == 1 && fseek(fp, 0, SEEK_SET) == 0)
+                fwrite(&header, sizeof(header), 1, fp);
+            fclose(fp);
+        }
+    }
+    setIntegerParam(lifeSamples_, lf->count);
+    estimateLife();
+}
+
+/* Least squares line through n points, false if x doesn't vary */
+static bool fitLine(const double *x, const double *y, unsigned int n, double *slope, double *offset)
+{
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0, det;
+
+    for (unsigned int i = 0; i < n; i++) {
+        sumX += x[i];
+        sumY += y[i];
+        sumXX += x[i]*x[i];
+        sumXY += x[i]*y[i];
+    }
+    det = n*sumXX - sumX*sumX;
+    if (n < 2 || det <= 0)
+        return false;
+    *slope = (n*sumXY - sumX*sumY) / det;
+    *offset = (sumY - *slope*sumX) / n;
+    return true;
+}
+
+/* The filament current needed for the emission rises as the filament thins and the EM
+ * needs more voltage for the same gain as it ages. Both are fitted against the on-hours
+ * of the part in use and extrapolated to their limits. */
+void drvInficon::estimateLife()
+{
+    lifeStruct *lf = life_;
+    double slope, offset, remain;
+    unsigned int nFil = 0, nEm = 0, idx, fil;
+
+    if (lf->count == 0)
+        return;
+    fil = lf->record[(lf->head + LIFE_SIZE - 1) % LIFE_SIZE].filSel;
+
+    for (unsigned int i = 0; i < lf->count; i++) {
+        const lifeRecordStruct *rec = &lf->record[(lf->head + LIFE_SIZE - lf->count + i) % LIFE_SIZE];
+        if ((fil == 1 || fil == 2) && rec->filSel == fil && rec->filCurrent > 0) {
+            lf->x[nFil] = rec->filHours[fil - 1];
+            lf->y[nFil] = rec->filCurrent;
+            nFil++;
+        }
+    }
+    remain = -1;
+    slope = 0;
+    if (nFil >= LIFE_MIN_SAMPLES && fitLine(lf->x, lf->y, nFil, &slope, &offset) && slope > 0) {
+        idx = nFil - 1;
+        remain = (lf->filCurrentLimit - (offset + slope*lf->x[idx])) / slope;
+        if (remain < 0) remain = 0;
+    }
+    setDoubleParam(lifeFilRate_, slope * 1000.0);
+    setDoubleParam(lifeFilRemain_, remain);
+
+    for (unsigned int i = 0; i < lf->count; i++) {
+        const lifeRecordStruct *rec = &lf->record[(lf->head + LIFE_SIZE - lf->count + i) % LIFE_SIZE];
+        if (rec->emV > 0) {
+            lf->x[nEm] = rec->emHours;
+            lf->y[nEm] = rec->emV;
+            nEm++;
+        }
+    }
+    remain = -1;
+    slope = 0;
+    if (nEm >= LIFE_MIN_SAMPLES && fitLine(lf->x, lf->y, nEm, &slope, &offset) && slope > 0 &&
+        sensDetect_->emVMax > 0) {
+        idx = nEm - 1;
+        remain = (sensDetect_->emVMax - (offset + slope*lf->x[idx])) / slope;
+        if (remain < 0) remain = 0;
+    }
+    setDoubleParam(lifeEmRate_, slope * 1000.0);
+    setDoubleParam(lifeEmRemain_, remain);
+}
+
+/* Clear one trend scale, addresses 1..TREND_SCALES */
+void drvInficon::resetTrend(unsigned int scale)
+{
+    trendScaleStruct *ts = &trend_->scale[scale];
+
+    ts->head = 0;
+    ts->count = 0;
+    ts->bucketStart = 0;
+    ts->accCount = 0;
+    ts->dirty = true;
+    setIntegerParam(scale, trendPoints_, 0);
+}
+
+/* Close the open bucket of a scale into its ring */
+static void closeTrendBucket(trendScaleStruct *ts)
+{
+    for (unsigned int c = 0; c < TREND_CHANNELS; c++) {
+        ts->min[c][ts->head] = ts->accMin[c];
+        ts->max[c][ts->head] = ts->accMax[c];
+        ts->mean[c][ts->head] = (float)(ts->accSum[c] / ts->accCount);
+    }
+    ts->time[ts->head] = ts->bucketStart;
+    ts->head = (ts->head + 1) % TREND_SIZE;
+    if (ts->count < TREND_SIZE)
+        ts->count++;
+    ts->accCount = 0;
+    ts->dirty = true;
+}
+
+/* Feed one diagnostic sample to every scale. A scale with a zero bucket keeps each
+ * sample, the others keep min/max/mean per bucket of their width. */
+void drvInficon::pushTrend(const epicsTimeStamp *sampleTime)
+{
+    double now = sampleTime->secPastEpoch + sampleTime->nsec * 1e-9;
+    float value[TREND_CHANNELS];
+    trendScaleStruct *ts;
+
+    value[TREND_BOX_TEMP]       = (float)diagData_->boxTemp;
+    value[TREND_ANODE_POT]      = (float)diagData_->anodePot;
+    value[TREND_FOCUS_POT]      = (float)diagData_->focusPot;
+    value[TREND_FIL_POT]        = (float)diagData_->filPot;
+    value[TREND_ELECT_ENERGY]   = (float)diagData_->electEng;
+    value[TREND_EMI_CURRENT]    = (float)diagData_->emiCurrent;
+    value[TREND_FIL_CURRENT]    = (float)diagData_->filCurrent;
+    value[TREND_EM_POT]         = (float)diagData_->emPot;
+
+    for (unsigned int s = 1; s <= TREND_SCALES; s++) {
+        ts = &trend_->scale[s];
+        if (ts->accCount > 0 && now - ts->bucketStart >= ts->bucket) {
+            closeTrendBucket(ts);
+            setIntegerParam(s, trendPoints_, ts->count);
+        }
+        if (ts->accCount == 0) {
+            ts->bucketStart = now;
+            for (unsigned int c = 0; c < TREND_CHANNELS; c++) {
+                ts->accMin[c] = ts->accMax[c] = value[c];
+                ts->accSum[c] = 0;
+            }
+        }
+        for (unsigned int c = 0; c < TREND_CHANNELS; c++) {
+            if (value[c] < ts->accMin[c]) ts->accMin[c] = value[c];
+            if (value[c] > ts->accMax[c]) ts->accMax[c] = value[c];
+            ts->accSum[c] += value[c];
+        }
+        ts->accCount++;
+        //without a bucket width every sample is a point of its own
+        if (ts->bucket <= 0) {
+            closeTrendBucket(ts);
+            setIntegerParam(s, trendPoints_, ts->count);
+        }
+    }
+}
+
+/* Publish the selected channel of every scale that got new points since the last call.
+ * Called at the base diagnostic rate so faster sampling doesn't add CA traffic. */
+void drvInficon::publishTrends(bool all)
+{
+    trendStruct *tr = trend_;
+    trendScaleStruct *ts;
+    unsigned int idx, c = tr->channel;
+    double newest;
+
+    for (unsigned int s = 1; s <= TREND_SCALES; s++) {
+        ts = &tr->scale[s];
+        if (!ts->dirty && !all)
+            continue;
+        ts->dirty = false;
+
+        newest = (ts->count > 0) ? ts->time[(ts->head + TREND_SIZE - 1) % TREND_SIZE] : 0;
+        for (unsigned int i = 0; i < ts->count; i++) {
+            idx = (ts->head + TREND_SIZE - ts->count + i) % TREND_SIZE;
+            tr->outTime[i] = (float)(ts->time[idx] - newest);
+            tr->outMin[i] = ts->min[c][idx];
+            tr->outMax[i] = ts->max[c][idx];
+            tr->outMean[i] = ts->mean[c][idx];
+        }
+        doCallbacksFloat32Array(tr->outTime, ts->count, trendTime_, s);
+        doCallbacksFloat32Array(tr->outMin, ts->count, trendMin_, s);
+        doCallbacksFloat32Array(tr->outMax, ts->count, trendMax_, s);
+        doCallbacksFloat32Array(tr->outMean, ts->count, trendMean_, s);
+        callParamCallbacks(s);
+    }
+}
+
+/* Compare the error and warning words with the previous status read, log every bit that
+ * changed and rebuild the active fault summary. Returns true if anything changed. */
+bool drvInficon::decodeFaults(unsigned int hwError, unsigned int hwWarn)
+{
+    faultStruct *fl = faults_;
+    unsigned int changed[2], word[2] = {hwError, hwWarn};
+    faultEventStruct *ev;
+    epicsTimeStamp now;
+    size_t len = 0;
+    int active = 0;
+
+    //the first read reports whatever is active at startup
+    changed[0] = fl->valid ? (hwError ^ fl->hwError) : hwError;
+    changed[1] = fl->valid ? (hwWarn ^ fl->hwWarn) : hwWarn;
+    fl->valid = true;
+    fl->hwError = hwError;
+    fl->hwWarn = hwWarn;
+    if (changed[0] == 0 && changed[1] == 0)
+        return false;
+
+    epicsTimeGetCurrent(&now);
+    for (int w = 0; w < 2; w++) {
+        for (unsigned int bit = 0; bit < 32; bit++) {
+            if (!(changed[w] & (1u << bit)))
+                continue;
+            ev = &fl->event[fl->head];
+            ev->time = now;
+            ev->warning = (w == 1);
+            ev->bit = bit;
+            ev->set = (word[w] & (1u << bit)) != 0;
+            fl->head = (fl->head + 1) % FAULT_LOG_SIZE;
+            if (fl->count < FAULT_LOG_SIZE)
+                fl->count++;
+            fl->total++;
+        }
+    }
+
+    //active faults, errors first
+    fl->activeText[0] = '\0';
+    for (int w = 0; w < 2; w++) {
+        for (unsigned int bit = 0; bit < 32; bit++) {
+            if (!(word[w] & (1u << bit)))
+                continue;
+            if (len < sizeof(fl->activeText))
+                len += epicsSnprintf(fl->activeText + len, sizeof(fl->activeText) - len, "%s%s %s",
+                                     (active > 0) ? ", " : "", (w == 0) ? "ERR" : "WARN", hwFaultNames[bit]);
+            active++;
+        }
+    }
+    setStringParam(faultActive_, fl->activeText);
+    setIntegerParam(faultActiveCount_, active);
+    setIntegerParam(faultEventCount_, fl->total);
+    publishFaultLog();
+    return true;
+}
+
+/* Format the event ring newest first, one line per transition */
+void drvInficon::publishFaultLog()
+{
+    faultStruct *fl = faults_;
+    const faultEventStruct *ev;
+    char stamp[40];
+    size_t len = 0;
+
+    fl->logText[0] = '\0';
+    for (unsigned int i = 0; i < fl->count && len < sizeof(fl->logText); i++) {
+        ev = &fl->event[(fl->head + FAULT_LOG_SIZE - 1 - i) % FAULT_LOG_SIZE];
+        epicsTimeToStrftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S.%03f", &ev->time);
+        len += epicsSnprintf(fl->logText + len, sizeof(fl->logText) - len, "%s %-4s %-5s bit %2u %s\n",
+                             stamp, ev->warning ? "WARN" : "ERR", ev->set ? "SET" : "CLEAR", ev->bit,
+                             hwFaultNames[ev->bit]);
+    }
+    setStringParam(faultLog_, fl->logText);
+}
+
+/* The device error log, read only when the error or warning words change */
+asynStatus drvInficon::parseErrorLog(const char *jsonData, char *errorLog, size_t maxChars)
+{
+    static const char *functionName = "parseErrorLog";
+    size_t len = 0;
+
+    errorLog[0] = '\0';
+    try {
+        json j = json::parse(jsonData);
+        std::string jstring;
+
+        //entries are kept as the device formats them
+        if (j["data"].is_array()) {
+            for (auto& entry : j["data"]) {
+                jstring = entry.is_string() ? entry.get<std::string>() : entry.dump();
+                if (len < maxChars)
+                    len += epicsSnprintf(errorLog + len, maxChars - len, "%s\n", jstring.c_str());
+            }
+        } else {
+            jstring = j["data"].is_string() ? j["data"].get<std::string>() : j["data"].dump();
+            epicsSnprintf(errorLog, maxChars, "%s", jstring.c_str());
+        }
+    }
+	catch (const json::parse_error& e) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s JSON error parsing string: %s\n", driverName, functionName, e.what());
+        return asynError;
+    }
+    catch (std::exception& e) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, 
+            "%s::%s other error parsing string: %s\n", driverName, functionName, e.what());
+        return asynError;
+    }
+    return asynSuccess;
+}
+
+/* Parse "tcp:port", "tcp:host:port" or "unix:path", a bare port binds to the loopback only */
+static bool parseStreamEndpoint(const char *endpoint, struct sockaddr_storage *addr, socklen_t *addrLen)
+{
+    char host[CAPTURE_PATH_SIZE];
+    const char *colon;
+    char *end;
+    long port;
+
+    memset(addr, 0, sizeof(*addr));
+    if (strncmp(endpoint, "unix:", 5) == 0) {
+        struct sockaddr_un *un = (struct sockaddr_un *)addr;
+        if (endpoint[5] == '\0' || strlen(endpoint + 5) >= sizeof(un->sun_path))
+            return false;
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, endpoint + 5);
+        *addrLen = sizeof(struct sockaddr_un);
+        return true;
+    }
+    if (strncmp(endpoint, "tcp:", 4) != 0)
+        return false;
+
+    struct sockaddr_in *in = (struct sockaddr_in *)addr;
+    in->sin_family = AF_INET;
+    in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    endpoint += 4;
+    colon = strrchr(endpoint, ':');
+    if (colon != NULL) {
+        if ((size_t)(colon - endpoint) >= sizeof(host))
+            return false;
+        memcpy(host, endpoint, colon - endpoint);
+        host[colon - endpoint] = '\0';
+        if (inet_pton(AF_INET, host, &in->sin_addr) != 1)
+            return false;
+        endpoint = colon + 1;
+    }
+    port = strtol(endpoint, &end, 10);
+    if (end == endpoint || *end != '\0' || port < 1 || port > 65535)
+        return false;
+    in->sin_port = htons((unsigned short)port);
+    *addrLen = sizeof(struct sockaddr_in);
+    return true;
+}
+
+/* Drop a client and release the frames still queued for it, called with streamLock_ held */
+void drvInficon::closeStreamClient(streamClientStruct *client)
+{
+    streamStruct *st = stream_;
+
+    for (unsigned int i = 0; i < client->count; i++)
+        st->pool[client->queue[(client->head + i) % STREAM_MAX_QUEUE]].refs--;
+    close(client->fd);
+    client->fd = -1;
+    client->head = 0;
+    client->count = 0;
+    client->sent = 0;
+    client->drops = 0;
+}
+
+/* Close the listening socket and every client and free the frame pool, called with
+ * streamLock_ held */
+void drvInficon::closeStreamServer()
+{
+    streamStruct *st = stream_;
+
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        if (st->client[i].fd >= 0)
+            closeStreamClient(&st->client[i]);
+    }
+    delete [] st->pool;
+    st->pool = NULL;
+    if (st->listenFd >= 0) {
+        close(st->listenFd);
+        st->listenFd = -1;
+        if (st->unixPath[0] != '\0')
+            unlink(st->unixPath);
+    }
+    st->unixPath[0] = '\0';
+}
+
+/* Open the listening socket for the configured endpoint, the frame pool is only allocated
+ * when there is one. Called with streamLock_ held. */
+void drvInficon::openStreamServer()
+{
+    streamStruct *st = stream_;
+    struct sockaddr_storage addr;
+    socklen_t addrLen;
+    int fd, on = 1;
+    static const char *functionName = "openStreamServer";
+
+    if (st->endpoint[0] == '\0' || !parseStreamEndpoint(st->endpoint, &addr, &addrLen))
+        return;
+    if (st->pool == NULL) {
+        st->pool = new streamFrameStruct[STREAM_POOL_SIZE];
+        for (int i = 0; i < STREAM_POOL_SIZE; i++)
+            st->pool[i].refs = 0;
+    }
+
+    fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s can't create socket for %s: %s\n",
+                  driverName, functionName, st->endpoint, strerror(errno));
+        return;
+    }
+    if (addr.ss_family == AF_UNIX)
+        unlink(((struct sockaddr_un *)&addr)->sun_path);
+    else
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    if (bind(fd, (struct sockaddr *)&addr, addrLen) < 0 || listen(fd, STREAM_MAX_CLIENTS) < 0) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s can't listen on %s: %s\n",
+                  driverName, functionName, st->endpoint, strerror(errno));
+        close(fd);
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    st->listenFd = fd;
+    if (addr.ss_family == AF_UNIX)
+        strcpy(st->unixPath, ((struct sockaddr_un *)&addr)->sun_path);
+    asynPrint(pasynUserSelf, ASYN_TRACE_FLOW,
+              "%s::%s streaming spectra on %s\n",
+              driverName, functionName, st->endpoint);
+}
+
+/* Write as much of the client's queue as the socket takes without blocking. Header and
+ * payload go out with one sendmsg straight from the pooled frame. Returns false if the
+ * client has to be dropped. Called with streamLock_ held. */
+bool drvInficon::sendStreamClient(streamClientStruct *client)
+{
+    streamStruct *st = stream_;
+    streamFrameStruct *frame;
+    struct iovec iov[2];
+    struct msghdr msg;
+    size_t headerSize = sizeof(streamHeaderStruct);
+    size_t total;
+    ssize_t n;
+
+    while (client->count > 0) {
+        frame = &st->pool[client->queue[client->head]];
+        //the header is per client, it reports what this client has missed
+        if (client->sent == 0) {
+            client->header = frame->header;
+            client->header.dropped = client->drops;
+            client->drops = 0;
+        }
+        total = headerSize + 2 * frame->header.points * sizeof(float);
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        if (client->sent < headerSize) {
+            iov[0].iov_base = (char *)&client->header + client->sent;
+            iov[0].iov_len = headerSize - client->sent;
+            iov[1].iov_base = frame->values;
+            iov[1].iov_len = 2 * frame->header.points * sizeof(float);
+            msg.msg_iovlen = 2;
+        } else {
+            iov[0].iov_base = (char *)frame->values + (client->sent - headerSize);
+            iov[0].iov_len = total - client->sent;
+            msg.msg_iovlen = 1;
+        }
+
+        n = sendmsg(client->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0)
+            return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+
+        client->sent += n;
+        if (client->sent < total)
+            return true;
+
+        client->sent = 0;
+        frame->refs--;
+        client->head = (client->head + 1) % STREAM_MAX_QUEUE;
+        client->count--;
+        st->frames++;
+    }
+    return true;
+}
+
+/* Hand a spectrum to the stream clients, called by the poller. The spectrum is copied once
+ * into a free pool frame shared by all queues, a client with a full queue misses it. */
+void drvInficon::streamScan(const scanDataStruct *scanData, int channel, int gate)
+{
+    streamStruct *st = stream_;
+    streamFrameStruct *frame = NULL;
+    streamClientStruct *client;
+    epicsTimeStamp now;
+    unsigned int points = scanData->scanSize;
+
+    if (points == 0 || points > MAX_SCAN_SIZE)
+        return;
+
+    epicsMutexLock(streamLock_);
+    if (st->clients == 0 || st->pool == NULL) {
+        epicsMutexUnlock(streamLock_);
+        return;
+    }
+
+    //the pool holds one frame more than all queues together, a free one always exists
+    for (unsigned int i = 0; i < STREAM_POOL_SIZE; i++) {
+        if (st->pool[i].refs == 0) {
+            frame = &st->pool[i];
+            break;
+        }
+    }
+    if (frame == NULL) {
+        epicsMutexUnlock(streamLock_);
+        return;
+    }
+
+    epicsTimeGetCurrent(&now);
+    frame->header.magic = STREAM_MAGIC;
+    frame->header.version = STREAM_VERSION;
+    frame->header.headerSize = sizeof(streamHeaderStruct);
+    frame->header.scanNumber = scanData->scanNumber;
+    frame->header.points = points;
+    frame->header.secPastEpoch = now.secPastEpoch;
+    frame->header.nsec = now.nsec;
+    frame->header.firstMass = scanData->amuValues[0];
+    frame->header.massStep = (points > 1) ? (scanData->amuValues[points-1] - scanData->amuValues[0]) / (points - 1) : 0;
+    frame->header.channel = (epicsUInt16)channel;
+    frame->header.gate = (epicsUInt16)gate;
+    frame->header.dropped = 0;
+    memcpy(frame->values, scanData->scanValues, points * sizeof(float));
+    memcpy(frame->values + points, scanData->amuValues, points * sizeof(float));
+
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        client = &st->client[i];
+        if (client->fd < 0)
+            continue;
+        if (client->count >= st->depth) {
+            client->drops++;
+            st->drops++;
+            continue;
+        }
+        client->queue[(client->head + client->count) % STREAM_MAX_QUEUE] = frame - st->pool;
+        client->count++;
+        frame->refs++;
+    }
+    epicsMutexUnlock(streamLock_);
+
+    //wake the stream thread, a full pipe already has it awake
+    if (write(st->wakeFd[1], "", 1) < 0) {}
+}
+
+static void streamThreadC(void *drvPvt)
+{
+    drvInficon *pPvt = (drvInficon *)drvPvt;
+
+    pPvt->streamThread();
+}
+
+
+/*
+****************************************************************************
+** Stream thread serving spectra to local analysis clients
+   One instance spawned per asyn port, owns all stream sockets and only
+   takes the port lock to publish its counters
+****************************************************************************
+*/
+
+void drvInficon::streamThread()
+{
+    streamStruct *st = stream_;
+    struct pollfd fds[STREAM_MAX_CLIENTS + 2];
+    int slot[STREAM_MAX_CLIENTS + 2];
+    unsigned int nfds;
+    int fd, listening, clients;
+    int lastListening = -1, lastClients = -1;
+    epicsUInt32 frames, drops, lastFrames = 0, lastDrops = 0;
+    char buf[256];
+
+    while (1)
+    {
+        epicsMutexLock(streamLock_);
+        if (st->reconfigure) {
+            st->reconfigure = false;
+            closeStreamServer();
+            openStreamServer();
+        }
+
+        //wake pipe first, then the listening socket and the clients
+        nfds = 0;
+        fds[nfds].fd = st->wakeFd[0];
+        fds[nfds].events = POLLIN;
+        slot[nfds++] = -1;
+        if (st->listenFd >= 0) {
+            fds[nfds].fd = st->listenFd;
+            fds[nfds].events = POLLIN;
+            slot[nfds++] = -1;
+        }
+        for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+            if (st->client[i].fd < 0)
+                continue;
+            fds[nfds].fd = st->client[i].fd;
+            fds[nfds].events = POLLIN | ((st->client[i].count > 0) ? POLLOUT : 0);
+            slot[nfds++] = i;
+        }
+        epicsMutexUnlock(streamLock_);
+
+        poll(fds, nfds, 1000);
+
+        if (inficonExiting_) break;
+
+        epicsMutexLock(streamLock_);
+        if (fds[0].revents & POLLIN) {
+            while (read(st->wakeFd[0], buf, sizeof(buf)) > 0) {}
+        }
+        for (unsigned int i = 1; i < nfds; i++) {
+            if (slot[i] < 0) {
+                //new connection, turned away if all client slots are taken
+                if (!(fds[i].revents & POLLIN) || st->listenFd < 0)
+                    continue;
+                fd = accept(st->listenFd, NULL, NULL);
+                if (fd < 0)
+                    continue;
+                for (int c = 0; c < STREAM_MAX_CLIENTS; c++) {
+                    if (st->client[c].fd < 0) {
+                        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                        st->client[c].fd = fd;
+                        fd = -1;
+                        break;
+                    }
+                }
+                if (fd >= 0)
+                    close(fd);
+                continue;
+            }
+
+            streamClientStruct *client = &st->client[slot[i]];
+            if (client->fd != fds[i].fd)
+                continue;
+            //clients don't send anything, readable means closed or garbage
+            if ((fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) ||
+                ((fds[i].revents & POLLIN) && read(client->fd, buf, sizeof(buf)) <= 0))
+                closeStreamClient(client);
+        }
+        //writable sockets take what they can, the rest waits for POLLOUT
+        for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+            if (st->client[i].fd >= 0 && st->client[i].count > 0 && !sendStreamClient(&st->client[i]))
+                closeStreamClient(&st->client[i]);
+        }
+
+        clients = 0;
+        for (int i = 0; i < STREAM_MAX_CLIENTS; i++)
+            if (st->client[i].fd >= 0) clients++;
+        st->clients = clients;
+        listening = (st->listenFd >= 0);
+        frames = st->frames;
+        drops = st->drops;
+        epicsMutexUnlock(streamLock_);
+
+        //most wakes change nothing, the port lock is never taken while holding streamLock_
+        if (listening == lastListening && clients == lastClients && frames == lastFrames && drops == lastDrops)
+            continue;
+        lastListening = listening;
+        lastClients = clients;
+        lastFrames = frames;
+        lastDrops = drops;
+        lock();
+        setIntegerParam(streamListening_, listening);
+        setIntegerParam(streamClients_, clients);
+        setIntegerParam(streamFrames_, frames);
+        setIntegerParam(streamDrops_, drops);
+        requestPublish();
+        unlock();
+    }
+
+    epicsMutexLock(streamLock_);
+    closeStreamServer();
+    epicsMutexUnlock(streamLock_);
+}
+
+/* Create the shared memory ring "/inficon_<port>" and map it */
+asynStatus drvInficon::openShm()
+{
+    inficonShmLayout *shm;
+    int fd;
+    static const char *functionName = "openShm";
+
+    if (shm_ != NULL)
+        return asynSuccess;
+
+    epicsSnprintf(shmPath_, sizeof(shmPath_), "/inficon_%s", this->portName);
+    fd = shm_open(shmPath_, O_CREAT | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(inficonShmLayout)) < 0) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s can't create %s: %s\n",
+                  driverName, functionName, shmPath_, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return asynError;
+    }
+    shm = (inficonShmLayout *)mmap(NULL, sizeof(inficonShmLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s can't map %s: %s\n",
+                  driverName, functionName, shmPath_, strerror(errno));
+        return asynError;
+    }
+
+    //readers check the magic last, a segment left by an earlier run is reset first
+    __atomic_store_n(&shm->magic, 0, __ATOMIC_RELEASE);
+    shm->version = INFICON_SHM_VERSION;
+    shm->slotSize = sizeof(inficonShmSlot);
+    shm->slots = INFICON_SHM_SLOTS;
+    strncpy(shm->portName, this->portName, sizeof(shm->portName) - 1);
+    shm->portName[sizeof(shm->portName) - 1] = '\0';
+    for (int i = 0; i < INFICON_SHM_SLOTS; i++)
+        shm->slot[i].seq = 0;
+    __atomic_store_n(&shm->writeCount, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&shm->magic, INFICON_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    shm_ = shm;
+    setStringParam(shmName_, shmPath_);
+    return asynSuccess;
+}
+
+/* Unmap and remove the segment, mapped readers keep their view until they unmap */
+void drvInficon::closeShm()
+{
+    if (shm_ == NULL)
+        return;
+
+    munmap(shm_, sizeof(inficonShmLayout));
+    shm_unlink(shmPath_);
+    shm_ = NULL;
+    setStringParam(shmName_, "");
+}
+
+/* Write a spectrum to the next slot. The slot counter is odd while the data changes, so
+ * readers can tell a torn read and never have to take a lock. */
+void drvInficon::shmScan(const scanDataStruct *scanData, int channel, int gate)
+{
+    inficonShmLayout *shm = shm_;
+    inficonShmSlot *slot;
+    epicsTimeStamp now;
+    uint64_t count;
+    unsigned int points = scanData->scanSize;
+
+    if (shm == NULL || points == 0 || points > INFICON_SHM_MAX_POINTS)
+        return;
+
+    count = __atomic_load_n(&shm->writeCount, __ATOMIC_RELAXED);
+    slot = &shm->slot[count % INFICON_SHM_SLOTS];
+    epicsTimeGetCurrent(&now);
+
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->scanNumber = scanData->scanNumber;
+    slot->points = points;
+    slot->secPastEpoch = now.secPastEpoch;
+    slot->nsec = now.nsec;
+    slot->channel = (epicsUInt16)channel;
+    slot->gate = (epicsUInt16)gate;
+    memcpy(slot->values, scanData->scanValues, points * sizeof(float));
+    memcpy(slot->masses, scanData->amuValues, points * sizeof(float));
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&shm->writeCount, count + 1, __ATOMIC_RELEASE);
+
+    setIntegerParam(shmWrites_, (int)(count + 1));
+}
+
+/* Publish the identity of the spectrum about to go out. Called before the arrays so the
+ * scalars are already posted when the scan array triggers the pvAccess group. */
+void drvInficon::publishScanMeta(const scanDataStruct *scanData, int channel, int gate)
+{
+    scanMetaStruct *meta = scanMeta_;
+    unsigned int last = (scanData->scanSize > 0) ? scanData->scanSize - 1 : 0;
+
+    //a new axis version whenever the mass of a point may have changed
+    if (scanData->scanSize != meta->scanSize || scanData->amuValues[0] != meta->firstMass ||
+        scanData->amuValues[last] != meta->lastMass || cal_->fits != meta->calFits) {
+        meta->scanSize = scanData->scanSize;
+        meta->firstMass = scanData->amuValues[0];
+        meta->lastMass = scanData->amuValues[last];
+        meta->calFits = cal_->fits;
+        meta->axisVersion++;
+    }
+
+    setIntegerParam(scanNumber_, scanData->scanNumber);
+    setIntegerParam(scanChannel_, channel);
+    setIntegerParam(scanGate_, gate);
+    setIntegerParam(massAxisVersion_, meta->axisVersion);
+    callParamCallbacks(0);
+}
+
+/* Hand a completed scan to the publish thread, called with the port locked.
+ * Only the newest scan is kept, one still waiting is overwritten. */
+void drvInficon::queueScan(const scanDataStruct *scanData, unsigned int channel, int gate, bool valid)
+{
+    publishStruct *pub = publish_;
+    publishSnapStruct *snap = &pub->pending;
+    unsigned int size = (scanData->scanSize < MAX_SCAN_SIZE) ? scanData->scanSize : MAX_SCAN_SIZE;
+
+    epicsMutexLock(publishLock_);
+    if (pub->scanPending)
+        pub->coalesced++;
+    snap->scan.scanSize = size;
+    snap->scan.actualScanSize = scanData->actualScanSize;
+    snap->scan.scanNumber = scanData->scanNumber;
+    memcpy(snap->scan.scanValues, scanData->scanValues, size * sizeof(float));
+    memcpy(snap->scan.amuValues, scanData->amuValues, size * sizeof(float));
+    snap->channel = channel;
+    snap->gate = gate;
+    snap->valid = valid;
+    snap->generation = pub->generation;
+    snap->decimSize = decim_->size;
+    memcpy(snap->decimScan, decim_->scanValues, decim_->size * sizeof(float));
+    memcpy(snap->decimAmu, decim_->amuValues, decim_->size * sizeof(float));
+    snap->convSize = conv_->size;
+    memcpy(snap->conv, conv_->values, conv_->size * sizeof(float));
+    pub->scanPending = true;
+    epicsMutexUnlock(publishLock_);
+
+    epicsEventSignal(publishEventId_);
+}
+
+/* Have the publish thread send an array that lives in driver state, called with the port
+ * locked. A newer request for the same parameter replaces one not yet sent. */
+void drvInficon::queueArray(float *values, size_t size, int reason, int addr)
+{
+    publishStruct *pub = publish_;
+    unsigned int i;
+    static const char *functionName = "queueArray";
+
+    for (i = 0; i < pub->numArrays; i++) {
+        if (pub->array[i].reason == reason && pub->array[i].addr == addr)
+            break;
+    }
+    if (i == PUBLISH_MAX_ARRAYS) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                  "%s::%s array queue full, reason %d dropped\n",
+                  driverName, functionName, reason);
+        return;
+    }
+    if (i == pub->numArrays)
+        pub->numArrays++;
+    pub->array[i].values = values;
+    pub->array[i].size = size;
+    pub->array[i].reason = reason;
+    pub->array[i].addr = addr;
+    epicsEventSignal(publishEventId_);
+}
+
+/* Ask the publish thread for parameter callbacks on every address, called with the port locked */
+void drvInficon::requestPublish()
+{
+    publish_->params = true;
+    epicsEventSignal(publishEventId_);
+}
+
+static void publishThreadC(void *drvPvt)
+{
+    drvInficon *pPvt = (drvInficon *)drvPvt;
+
+    pPvt->publishThread();
+}
+
+
+/*
+****************************************************************************
+** Publish thread for parameter and spectrum callbacks
+   One instance spawned per asyn port. The I/O threads (poller, bulk, pressure,
+   capture, stream) only queue what changed, so record processing never holds
+   up a device request. Requests that arrive while a publish is running are
+   served together.
+****************************************************************************
+*/
+
+void drvInficon::publishThread()
+{
+    publishStruct *pub = publish_;
+    publishSnapStruct *out = &pub->out;
+    epicsTimeStamp startTime, stopTime;
+    bool scan, params, clear, current;
+    unsigned int coalesced, dirty, clearSize, clearDecimSize;
+
+    while (1)
+    {
+        epicsEventWait(publishEventId_);
+
+        if (inficonExiting_) break;
+
+        epicsTimeGetCurrent(&startTime);
+
+        //take the newest scan, the bulk thread can queue the next one meanwhile
+        epicsMutexLock(publishLock_);
+        clear = pub->clear;
+        pub->clear = false;
+        clearSize = out->scan.scanSize;
+        clearDecimSize = out->decimSize;
+        scan = pub->scanPending;
+        if (scan) {
+            out->scan.scanSize = pub->pending.scan.scanSize;
+            out->scan.actualScanSize = pub->pending.scan.actualScanSize;
+            out->scan.scanNumber = pub->pending.scan.scanNumber;
+            memcpy(out->scan.scanValues, pub->pending.scan.scanValues, out->scan.scanSize * sizeof(float));
+            memcpy(out->scan.amuValues, pub->pending.scan.amuValues, out->scan.scanSize * sizeof(float));
+            out->channel = pub->pending.channel;
+            out->gate = pub->pending.gate;
+            out->valid = pub->pending.valid;
+            out->generation = pub->pending.generation;
+            out->decimSize = pub->pending.decimSize;
+            memcpy(out->decimScan, pub->pending.decimScan, out->decimSize * sizeof(float));
+            memcpy(out->decimAmu, pub->pending.decimAmu, out->decimSize * sizeof(float));
+            out->convSize = pub->pending.convSize;
+            memcpy(out->conv, pub->pending.conv, out->convSize * sizeof(float));
+            pub->scanPending = false;
+        }
+        coalesced = pub->coalesced;
+        epicsMutexUnlock(publishLock_);
+
+        lock();
+        //a monitor restart since the scan was taken makes it stale
+        epicsMutexLock(publishLock_);
+        current = scan && out->generation == pub->generation;
+        epicsMutexUnlock(publishLock_);
+        //scan number, channel and axis version go out ahead of the arrays
+        if (current && out->valid)
+            publishScanMeta(&out->scan, out->channel, out->gate);
+        if (current)
+            publishRois(&out->scan);
+        if (pub->trends) {
+            pub->trends = false;
+            publishTrends(false);
+        }
+        publishGates();
+
+        setIntegerParam(publishScans_, pub->scans);
+        setIntegerParam(publishCoalesced_, coalesced);
+        setDoubleParam(publishTime_, pub->lastTime);
+        setDoubleParam(publishTimeMax_, pub->maxTime);
+        params = pub->params;
+        pub->params = false;
+        if (params) {
+            //address 0 every time, the others only if something was set on them
+            dirty = dirtyAddr_ | 0x1;
+            dirtyAddr_ = 0;
+            for (int i=0; i<MAX_CHANNELS; i++) {
+                if (dirty & (1u << i))
+                    callParamCallbacks(i);
+            }
+        }
+        //analytics arrays point into driver state, they go out under the port lock
+        for (unsigned int i = 0; i < pub->numArrays; i++)
+            doCallbacksFloat32Array(pub->array[i].values, pub->array[i].size, pub->array[i].reason, pub->array[i].addr);
+        pub->numArrays = 0;
+        unlock();
+
+        //clear screen for the user, array sizes from the previous scan
+        if (clear) {
+            doCallbacksFloat32Array(pub->zeros, clearSize, getScan_, 0);
+            doCallbacksFloat32Array(pub->zeros, clearSize, getXCoord_, 0);
+            doCallbacksFloat32Array(pub->zeros, clearDecimSize, decimXCoord_, 0);
+            doCallbacksFloat32Array(pub->zeros, clearDecimSize, decimScan_, 0);
+        }
+
+        //a restart while the port was held blanks the screen next time round, don't send over it
+        if (current) {
+            epicsMutexLock(publishLock_);
+            current = (out->generation == pub->generation);
+            epicsMutexUnlock(publishLock_);
+        }
+
+        //the full size arrays are owned by this thread, no need to hold the port
+        if (current) {
+            //update x coordinate data
+            doCallbacksFloat32Array(out->scan.amuValues, out->scan.scanSize, getXCoord_, 0);
+
+            //update scan/measurement data
+            doCallbacksFloat32Array(out->scan.scanValues, out->scan.scanSize, getScan_, 0);
+
+            //reduced copy for displays
+            doCallbacksFloat32Array(out->decimAmu, out->decimSize, decimXCoord_, 0);
+            doCallbacksFloat32Array(out->decimScan, out->decimSize, decimScan_, 0);
+
+            //gas corrected partial pressures, only once the sensitivity is known
+            if (out->convSize > 0)
+                doCallbacksFloat32Array(out->conv, out->convSize, convScan_, 0);
+            pub->scans++;
+        }
+
+        epicsTimeGetCurrent(&stopTime);
+        pub->lastTime = epicsTimeDiffInSeconds(&stopTime, &startTime) * 1000.0;
+        if (pub->lastTime > pub->maxTime)
+            pub->maxTime = pub->lastTime;
+    }
+}
+
+static void bulkThreadC(void *drvPvt)
+{
+    drvInficon *pPvt = (drvInficon *)drvPvt;
+
+    pPvt->bulkThread();
+}
+
+
+/*
+****************************************************************************
+** Bulk thread reading spectra on the bulk connection
+   One instance spawned per asyn port, the poller hands it each new scan.
+   The body is read without the port lock, so status requests, total
+   pressure and writes go on over the control connection meanwhile.
+****************************************************************************
+*/
+
+void drvInficon::bulkThread()
+{
+    char request[HTTP_REQUEST_SIZE];
+    asynStatus status;
+    unsigned int scanChannel;
+    int gateTag;
+
+    static const char *functionName="bulkThread";
+
+    sprintf(request,"GET /mmsp/measurement/scans/-1/get\r\n"
+                    "\r\n");
+
+    while (1)
+    {
+        epicsEventWait(bulkEventId_);
+
+        if (inficonExiting_) break;
+
+        /*Get scan values from last successfull scan*/
+        status = inficonReadWrite(request, bulk_->data, LANE_BULK);
+
+        lock();
+        scanChannel = bulk_->channel;
+
+        //monitoring was restarted or stopped while the body was on its way
+        if (bulk_->discard || (mainState_ != MONITORING && mainState_ != SEQUENCE)) {
+            bulk_->discard = false;
+            bulk_->busy = false;
+            unlock();
+            continue;
+        }
+
+        if (status == asynSuccess)
+            status = parseScan(bulk_->data, scanData_, scanChannel);
+        if (status) {
+            asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+                      "%s:%s: ERROR reading scan data, status=%d\n",
+                      driverName, functionName, status);
+        } else {
+            captureScan(scanData_, scanChannel, &bulk_->scanEnd);
+            processScan(scanData_);
+        }
+
+        //in keep mode only scans overlapping a gate are published
+        gateTag = (status == asynSuccess) ? gateScan(scanData_, &bulk_->scanEnd, bulk_->scanPeriod) : 0;
+        if (gates_->mode != GATE_KEEP || gateTag > 0) {
+            //the arrays go out from the publish thread
+            queueScan(scanData_, scanChannel, gateTag, status == asynSuccess);
+
+            //every published spectrum also goes to the local stream clients and shared memory
+            if (status == asynSuccess) {
+                streamScan(scanData_, scanChannel, gateTag);
+                shmScan(scanData_, scanChannel, gateTag);
+            }
+        }
+
+        bulk_->busy = false;
+        requestPublish();
+        unlock();
+    }
+}
+
+/* Per connection request statistics on addresses LANE_CONTROL to LANE_PRESSURE */
+void drvInficon::publishLaneStats()
+{
+    laneStatsStruct ls;
+
+    for (int lane = LANE_CONTROL; lane <= LANE_PRESSURE; lane++) {
+        epicsMutexLock(laneLock_);
+        ls = laneStats_[lane];
+        epicsMutexUnlock(laneLock_);
+        setIntegerParam(lane, laneRequests_, ls.requests);
+        setIntegerParam(lane, laneErrors_, ls.errors);
+        setDoubleParam(lane, laneLatency_, ls.lastLatency);
+        setDoubleParam(lane, laneLatencyMax_, ls.maxLatency);
+        setDoubleParam(lane, laneLatencyMean_, (ls.requests > 0) ? ls.sumLatency / ls.requests : 0);
+        setDoubleParam(lane, laneKBytes_, ls.bytes / 1024.0);
+    }
+}
+
+/* Follow the running scan from the scan info just read. Measures the scan
+ * period from completions seen and predicts when the current scan ends. */
+void drvInficon::predictScan(unsigned int channel)
+{
+    scanPredictStruct *p = scanPredict_;
+    epicsTimeStamp now;
+    double measured;
+    unsigned int dwell;
+
+    epicsTimeGetCurrent(&now);
+
+    //new scan setup or restarted measurement, start over from the channel setup
+    if ((int)channel != p->channel || scanInfo_->ppScan != p->points || scanInfo_->lastScan < p->lastScan) {
+        p->channel = channel;
+        p->points = scanInfo_->ppScan;
+        dwell = (channel < MAX_CHANNELS) ? chScanSetup_[channel].chDwell : 0;
+        p->period = (dwell > 0 && p->points > 0) ? p->points * dwell / 1000.0 + SCAN_OVERHEAD : 0;
+        p->lastScan = scanInfo_->lastScan;
+        p->timed = false;
+        p->predicted = false;
+    }
+
+    if (scanInfo_->lastScan > p->lastScan) {
+        if (p->predicted)
+            p->error = epicsTimeDiffInSeconds(&now, &p->nextDone) * 1000.0;
+        //it completed since the previous look, a prediction in that interval narrows it down
+        if (p->lastPoll.secPastEpoch == 0) {
+            p->doneEstimate = now;
+        } else if (p->predicted && epicsTimeDiffInSeconds(&p->nextDone, &p->lastPoll) > 0 &&
+                   epicsTimeDiffInSeconds(&now, &p->nextDone) >= 0) {
+            p->doneEstimate = p->nextDone;
+        } else {
+            p->doneEstimate = p->lastPoll;
+            epicsTimeAddSeconds(&p->doneEstimate, 0.5 * epicsTimeDiffInSeconds(&now, &p->lastPoll));
+        }
+        //the first completion seen only gives the reference time
+        if (p->timed) {
+            measured = epicsTimeDiffInSeconds(&now, &p->lastDone) / (scanInfo_->lastScan - p->lastScan);
+            p->period = (p->period > 0) ? p->period + SCAN_PERIOD_GAIN * (measured - p->period) : measured;
+        }
+        p->lastDone = now;
+        p->lastScan = scanInfo_->lastScan;
+        p->timed = true;
+    } else {
+        p->idlePolls++;
+    }
+
+    //progress of the running scan is the better guess, the last completion the fallback
+    p->predicted = (p->period > 0 && p->points > 0);
+    if (p->predicted && scanInfo_->pointsInScan > 0 && scanInfo_->pointsInScan < p->points) {
+        p->nextDone = now;
+        epicsTimeAddSeconds(&p->nextDone, (p->points - scanInfo_->pointsInScan) * p->period / p->points);
+    } else if (p->predicted && p->timed) {
+        p->nextDone = p->lastDone;
+        epicsTimeAddSeconds(&p->nextDone, p->period);
+    } else {
+        p->predicted = false;
+    }
+
+    p->lastPoll = now;
+    setDoubleParam(scanPeriodEst_, p->period);
+    setDoubleParam(scanPredictError_, p->error);
+    setIntegerParam(scanIdlePolls_, p->idlePolls);
+}
+
+/* How long the poller sleeps: until just after the predicted end of the scan, never
+ * longer than SCAN_SAFETY_POLL or past the next diagnostic trend sample, and tickWait
+ * when nothing is predicted */
+double drvInficon::scanWaitTime(bool scanning, double tickWait, const epicsTimeStamp *trendDue)
+{
+    scanPredictStruct *p = scanPredict_;
+    epicsTimeStamp now;
+    double wait, trendWait;
+
+    //a completed scan is still waiting for the bulk connection
+    if (!p->enable || !scanning || !p->predicted || scanInfo_->lastScan > lastPolledScan_)
+        return tickWait;
+
+    epicsTimeGetCurrent(&now);
+    wait = epicsTimeDiffInSeconds(&p->nextDone, &now) + SCAN_ALIGN_GUARD;
+    trendWait = epicsTimeDiffInSeconds(trendDue, &now);
+    //overdue, or a trend sample is due, look again at the normal rate
+    if (wait <= 0 || trendWait <= 0)
+        return tickWait;
+    if (wait < SCAN_ALIGN_GUARD)
+        wait = SCAN_ALIGN_GUARD;
+    if (wait > SCAN_SAFETY_POLL)
+        wait = SCAN_SAFETY_POLL;
+    //TREND_PERIOD may be shorter than the safety poll
+    if (wait > trendWait)
+        wait = trendWait;
+    return wait;
+}
+
+/* Bin edges of the poll cycle histogram, as a fraction of the poll period */
+static const double pollHistEdges[POLL_HIST_BINS - 1] = {0.25, 0.5, 0.75, 1.0, 1.5, 2.0, 4.0};
+
+/* End of a poller cycle that started at cycleStart. Moves the deadline to the
+ * next tick still ahead, on the grid of the first one, and returns the time
+ * left until it. Ticks that came due while the cycle ran are counted as skipped. */
+double drvInficon::pollClockTick(const epicsTimeStamp *cycleStart)
+{
+    pollClockStruct *c = pollClock_;
+    epicsTimeStamp now, from;
+    double cycle, late;
+    unsigned int bin;
+
+    epicsTimeGetCurrent(&now);
+    cycle = epicsTimeDiffInSeconds(&now, cycleStart);
+
+    //new period, start the grid here
+    if (c->restart) {
+        c->restart = false;
+        c->nextTick = *cycleStart;
+        epicsTimeAddSeconds(&c->nextTick, pollTime_);
+    } else {
+        c->lastCycle = cycle * 1000.0;
+        if (c->lastCycle > c->maxCycle)
+            c->maxCycle = c->lastCycle;
+        if (cycle > pollTime_)
+            c->overruns++;
+        for (bin = 0; bin < POLL_HIST_BINS - 1 && cycle >= pollHistEdges[bin] * pollTime_; bin++)
+            ;
+        c->hist[bin]++;
+
+        late = epicsTimeDiffInSeconds(&now, &c->nextTick);
+        if (late >= 0) {
+            //sleeping through ticks on purpose (scan aligned wake up) is not skipping them
+            from = (epicsTimeDiffInSeconds(cycleStart, &c->nextTick) > 0) ? *cycleStart : c->nextTick;
+            c->skipped += (unsigned int)floor(epicsTimeDiffInSeconds(&now, &from) / pollTime_);
+            epicsTimeAddSeconds(&c->nextTick, (floor(late / pollTime_) + 1) * pollTime_);
+        }
+    }
+
+    return epicsTimeDiffInSeconds(&c->nextTick, &now);
+}
+
+/* Poll clock statistics, histogram bins are counts of cycles */
+void drvInficon::publishPollClock()
+{
+    pollClockStruct *c = pollClock_;
+
+    setDoubleParam(pollCycle_, c->lastCycle);
+    setDoubleParam(pollCycleMax_, c->maxCycle);
+    setIntegerParam(pollOverruns_, c->overruns);
+    setIntegerParam(pollSkipped_, c->skipped);
+    for (unsigned int i = 0; i < POLL_HIST_BINS; i++)
+        c->histValues[i] = (float)c->hist[i];
+    queueArray(c->histValues, POLL_HIST_BINS, pollHist_, 0);
+}
+
 asynStatus drvInficon::verifyConnection() {
 	asynUser* usr = pasynManager->createAsynUser(NULL, NULL);
 	usr->timeout = 0.5; /* 500ms timeout */
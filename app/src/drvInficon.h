@@ -11,9 +11,15 @@
 
 #include <epicsThread.h>
 #include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsTime.h>
 
 #include <asynPortDriver.h>
 
+#include <vector>
+
+#include "inficonShm.h"
+
 //User defines
 #define PORT_PREFIX "PORT_"
 #define HTTP_OK_CODE "200"
@@ -22,9 +28,132 @@
 #define HTTP_RESPONSE_SIZE 150000
 #define MAX_CHANNELS 5
 #define MAX_SCAN_SIZE 16384
+#define BULK_PORT_SUFFIX "_BULK"
+#define PRESS_PORT_SUFFIX "_PRESS"
 
 //Poller thread
 #define DEFAULT_POLL_TIME 0.25
+#define MIN_POLL_TIME 0.05
+#define MAX_POLL_TIME 10.0
+#define POLL_HIST_BINS 8                    /* cycle time histogram, see pollHistEdges */
+#define SCAN_ALIGN_GUARD 0.02               /* wake this long after the predicted end of a scan [s] */
+#define SCAN_SAFETY_POLL 1.0                /* longest sleep while a scan is running [s] */
+#define SCAN_OVERHEAD 0.05                  /* per scan overhead before the first measurement [s] */
+#define SCAN_PERIOD_GAIN 0.2                /* weight of a measured period in the estimate */
+
+//Pressure thread
+#define DEFAULT_PRESS_POLL_TIME 0.1
+#define MIN_PRESS_POLL_TIME 0.01
+#define PRESS_HIST_SIZE 8192
+#define DEFAULT_PRESS_HIST_WINDOW 60.0
+#define DEFAULT_PRESS_STAT_WINDOW 10.0
+
+//Event capture
+#define CAPTURE_MAX_PRE 16
+#define CAPTURE_MAX_POST 16
+#define CAPTURE_RING_SIZE (CAPTURE_MAX_PRE + CAPTURE_MAX_POST)
+#define CAPTURE_PATH_SIZE 256
+#define DEFAULT_CAPTURE_PRE 8
+#define DEFAULT_CAPTURE_POST 4
+
+//Gated acquisition, per-gate results are published on asyn addresses 1..MAX_GATES
+#define MAX_GATES 4
+#define GATE_HIST_SIZE 1024
+
+//Sequence engine
+#define SEQ_MAX_STEPS 32
+#define SEQ_NAME_SIZE 40
+
+//Spectrum statistics, partial results per lane combined in a fixed order
+#define STATS_LANES 8
+
+//Decimated spectrum for displays
+#define MAX_DECIM_SIZE 4096
+#define PUBLISH_MAX_ARRAYS 32               /* analytics arrays queued for the publish thread */
+#define MIN_DECIM_SIZE 2
+#define DEFAULT_DECIM_SIZE 1000
+
+//Regions of interest use asyn addresses 1..MAX_ROIS, keep it below MAX_CHANNELS
+#define MAX_ROIS 4
+
+//Unit conversion, relative sensitivities are kept per nominal mass
+#define CONV_MAX_MASS 512
+
+//Mass axis calibration from reference peaks
+#define CAL_MAX_REFS 8
+#define CAL_WINDOW 0.5                      /* amu searched around each reference mass */
+#define DEFAULT_CAL_THRESHOLD 0.05
+#define DEFAULT_CAL_MIN_SNR 10.0
+
+//Peak shape analysis
+#define PEAK_MAX 8
+#define PEAK_FIT_POINTS 64
+#define PEAK_SEPARATION 0.5                 /* amu, closer maxima belong to the same peak */
+#define PEAK_TREND_SIZE 1024
+#define DEFAULT_PEAK_NUM 4
+#define DEFAULT_PEAK_MIN_SNR 10.0
+
+//Anomaly detection against a learned reference spectrum
+#define ANOM_TOP 5
+#define DEFAULT_ANOM_ALPHA 0.02
+#define DEFAULT_ANOM_THRESHOLD 9.0
+#define DEFAULT_ANOM_WARMUP 20
+#define DEFAULT_ANOM_RELEARN 0
+
+//Mass ratios use asyn addresses 1..RATIO_MAX, keep it below MAX_CHANNELS
+#define RATIO_MAX 4
+#define RATIO_HIST_SIZE 256
+#define RATIO_HYST 0.1                      /* relative widening of the air band once set */
+#define DEFAULT_RATIO_WIDTH 0.3
+#define DEFAULT_RATIO_WINDOW 20
+#define DEFAULT_AIR_LOW 3.0
+#define DEFAULT_AIR_HIGH 5.0
+#define DEFAULT_AIR_RATIO 1                 /* N2/O2 entry */
+#define DEFAULT_WATER_RATIO 3               /* H2O/OH entry, water cracks to 18/17 near 4 */
+#define DEFAULT_WATER_ON 3.0
+#define DEFAULT_WATER_OFF 2.5
+
+//Partial vs total pressure consistency
+#define CONS_HIST_SIZE 512
+#define CONS_MIN_SAMPLES 20                 /* ratios needed before a drift is estimated */
+#define DEFAULT_CONS_DRIFT_LIMIT 5.0        /* %/h */
+
+//EM gain calibration
+#define EMCAL_MAX_ITER 12
+#define EMCAL_LOG_SLOPE 0.007               /* d ln(gain)/dV used before two points are known */
+#define DEFAULT_EMCAL_TARGET 1000.0
+#define DEFAULT_EMCAL_TOLERANCE 2.0         /* % */
+#define DEFAULT_EMCAL_SCANS 2
+
+//Filament and EM lifetime store
+#define LIFE_SIZE 2048                      /* records kept in memory and in the store file */
+#define LIFE_MIN_SAMPLES 10                 /* records needed before a prediction */
+#define LIFE_MAGIC "INFL"
+#define LIFE_VERSION 2
+#define DEFAULT_LIFE_PERIOD 3600
+#define DEFAULT_LIFE_FIL_LIMIT 3000.0       /* mA */
+
+//Diagnostic trends
+#define TREND_CHANNELS 8
+#define TREND_SCALES 3                      /* asyn addresses 1..3 */
+#define TREND_SIZE 720                      /* points kept per scale */
+#define DEFAULT_TREND_PERIOD 5.0            /* diagnostic sampling period [s] */
+#define DEFAULT_TREND_BUCKET_1 0.0          /* every sample, 1 h at 5 s */
+#define DEFAULT_TREND_BUCKET_2 60.0         /* 12 h */
+#define DEFAULT_TREND_BUCKET_3 3600.0       /* 30 days */
+
+//Fault event log
+#define FAULT_LOG_SIZE 256                  /* transitions kept */
+#define FAULT_TEXT_SIZE 16384
+#define FAULT_ACTIVE_SIZE 1024
+
+//Spectrum streaming to local clients
+#define STREAM_MAX_CLIENTS 4
+#define STREAM_MAX_QUEUE 16                 /* frames per client */
+#define DEFAULT_STREAM_QUEUE 8
+#define STREAM_POOL_SIZE (STREAM_MAX_CLIENTS*STREAM_MAX_QUEUE + 1)
+#define STREAM_MAGIC 0x53464E49             /* "INFS" little endian */
+#define STREAM_VERSION 2
 
 /* These are the strings that device support passes to drivers via
  * the asynDrvUser interface.
@@ -35,7 +164,7 @@
 #define INFICON_GET_COMM_PARAM_STRING     "GET_COMM_PARAM"
 #define INFICON_IP_STRING                 "IP"
 #define INFICON_MAC_STRING                "MAC"
-//#define INFICON_ERROR_LOG_STRING          "ERROR_LOG"
+#define INFICON_ERROR_LOG_STRING          "ERROR_LOG"
 //General control
 #define INFICON_EMI_ON_STRING             "EMI_ON"
 #define INFICON_EM_ON_STRING              "EM_ON"
@@ -123,6 +252,211 @@
 #define DRIVER_STATE_STRING               "DRIVER_STATE"
 #define MONITOR_START_STRING              "MONITOR_START"
 #define LEAKCHECK_START_STRING            "LEAKCHECK_START"
+//Total pressure history
+#define PRESS_POLL_TIME_STRING            "PRESS_POLL_TIME"
+#define PRESS_HIST_WINDOW_STRING          "PRESS_HIST_WINDOW"
+#define PRESS_STAT_WINDOW_STRING          "PRESS_STAT_WINDOW"
+#define PRESS_HIST_STRING                 "PRESS_HIST"
+#define PRESS_HIST_TIME_STRING            "PRESS_HIST_TIME"
+#define PRESS_MIN_STRING                  "PRESS_MIN"
+#define PRESS_MAX_STRING                  "PRESS_MAX"
+#define PRESS_MEAN_STRING                 "PRESS_MEAN"
+//Event capture
+#define CAPTURE_ARM_STRING                "CAPTURE_ARM"
+#define CAPTURE_TRIG_STRING               "CAPTURE_TRIG"
+#define CAPTURE_PRE_STRING                "CAPTURE_PRE"
+#define CAPTURE_POST_STRING               "CAPTURE_POST"
+#define CAPTURE_PRESS_LEVEL_STRING        "CAPTURE_PRESS_LEVEL"
+#define CAPTURE_PRESS_RATE_STRING         "CAPTURE_PRESS_RATE"
+#define CAPTURE_DIR_STRING                "CAPTURE_DIR"
+#define CAPTURE_STATE_STRING              "CAPTURE_STATE"
+#define CAPTURE_BUSY_STRING               "CAPTURE_BUSY"
+#define CAPTURE_COUNT_STRING              "CAPTURE_COUNT"
+#define CAPTURE_MISSED_STRING             "CAPTURE_MISSED"
+#define CAPTURE_FILE_STRING               "CAPTURE_FILE"
+//Gated acquisition
+#define GATE_STRING                       "GATE"
+#define GATE_MODE_STRING                  "GATE_MODE"
+#define GATE_RESET_STRING                 "GATE_RESET"
+#define GATE_TAG_STRING                   "GATE_TAG"
+#define GATE_COUNT_STRING                 "GATE_COUNT"
+#define GATE_AVG_STRING                   "GATE_AVG"
+#define GATE_XCOORD_STRING                "GATE_XCOORD"
+//Sequence engine
+#define SEQ_FILE_STRING                   "SEQ_FILE"
+#define SEQ_START_STRING                  "SEQ_START"
+#define SEQ_STEPS_STRING                  "SEQ_STEPS"
+#define SEQ_STEP_STRING                   "SEQ_STEP"
+#define SEQ_STEP_NAME_STRING              "SEQ_STEP_NAME"
+#define SEQ_CYCLE_STRING                  "SEQ_CYCLE"
+#define SCAN_STEP_STRING                  "SCAN_STEP"
+#define SCAN_STEP_NAME_STRING             "SCAN_STEP_NAME"
+//Spectrum statistics
+#define STATS_THRESHOLD_STRING            "STATS_THRESHOLD"
+#define STATS_SUM_STRING                  "STATS_SUM"
+#define STATS_MEAN_STRING                 "STATS_MEAN"
+#define STATS_MAX_STRING                  "STATS_MAX"
+#define STATS_MAX_MASS_STRING             "STATS_MAX_MASS"
+#define STATS_NOISE_STRING                "STATS_NOISE"
+#define STATS_ABOVE_STRING                "STATS_ABOVE"
+#define STATS_DYN_RANGE_STRING            "STATS_DYN_RANGE"
+//Spectrum decimation
+#define DECIM_WIDTH_STRING                "DECIM_WIDTH"
+#define DECIM_SCAN_STRING                 "DECIM_SCAN"
+#define DECIM_XCOORD_STRING               "DECIM_XCOORD"
+//Regions of interest
+#define ROI_START_STRING                  "ROI_START"
+#define ROI_STOP_STRING                   "ROI_STOP"
+#define ROI_DIVIDER_STRING                "ROI_DIVIDER"
+#define ROI_POINTS_STRING                 "ROI_POINTS"
+#define ROI_SCAN_STRING                   "ROI_SCAN"
+#define ROI_XCOORD_STRING                 "ROI_XCOORD"
+//Unit conversion
+#define CONV_UNITS_STRING                 "CONV_UNITS"
+#define CONV_EGU_STRING                   "CONV_EGU"
+#define CONV_RSF_FILE_STRING              "CONV_RSF_FILE"
+#define CONV_RSF_COUNT_STRING             "CONV_RSF_COUNT"
+#define CONV_SCAN_STRING                  "CONV_SCAN"
+//Mass axis calibration
+#define CAL_ENABLE_STRING                 "CAL_ENABLE"
+#define CAL_ORDER_STRING                  "CAL_ORDER"
+#define CAL_THRESHOLD_STRING              "CAL_THRESHOLD"
+#define CAL_MIN_SNR_STRING                "CAL_MIN_SNR"
+#define CAL_C0_STRING                     "CAL_C0"
+#define CAL_C1_STRING                     "CAL_C1"
+#define CAL_C2_STRING                     "CAL_C2"
+#define CAL_RESIDUAL_STRING               "CAL_RESIDUAL"
+#define CAL_DRIFT_STRING                  "CAL_DRIFT"
+#define CAL_PEAKS_STRING                  "CAL_PEAKS"
+#define CAL_FITS_STRING                   "CAL_FITS"
+//Peak shape analysis
+#define PEAK_DIVIDER_STRING               "PEAK_DIVIDER"
+#define PEAK_NUM_STRING                   "PEAK_NUM"
+#define PEAK_MIN_SNR_STRING               "PEAK_MIN_SNR"
+#define PEAK_FOUND_STRING                 "PEAK_FOUND"
+#define PEAK_MASS_STRING                  "PEAK_MASS"
+#define PEAK_FWHM_STRING                  "PEAK_FWHM"
+#define PEAK_ASYM_STRING                  "PEAK_ASYM"
+#define PEAK_RES_STRING                   "PEAK_RES"
+#define PEAK_FWHM_MEAN_STRING             "PEAK_FWHM_MEAN"
+#define PEAK_RES_MEAN_STRING              "PEAK_RES_MEAN"
+#define PEAK_TREND_FWHM_STRING            "PEAK_TREND_FWHM"
+#define PEAK_TREND_RES_STRING             "PEAK_TREND_RES"
+//Anomaly detection
+#define ANOM_ENABLE_STRING                "ANOM_ENABLE"
+#define ANOM_RESET_STRING                 "ANOM_RESET"
+#define ANOM_ALPHA_STRING                 "ANOM_ALPHA"
+#define ANOM_THRESHOLD_STRING             "ANOM_THRESHOLD"
+#define ANOM_WARMUP_STRING                "ANOM_WARMUP"
+#define ANOM_RELEARN_STRING               "ANOM_RELEARN"
+#define ANOM_SCORE_STRING                 "ANOM_SCORE"
+#define ANOM_ALARM_STRING                 "ANOM_ALARM"
+#define ANOM_COUNT_STRING                 "ANOM_COUNT"
+#define ANOM_TOP_MASS_STRING              "ANOM_TOP_MASS"
+#define ANOM_TOP_SCORE_STRING             "ANOM_TOP_SCORE"
+#define ANOM_REF_STRING                   "ANOM_REF"
+//Mass ratios
+#define MASS_INTEGRAL_STRING              "MASS_INTEGRAL"
+#define MASS_INTEGRAL_MASS_STRING         "MASS_INTEGRAL_MASS"
+#define RATIO_WIDTH_STRING                "RATIO_WIDTH"
+#define RATIO_WINDOW_STRING               "RATIO_WINDOW"
+#define RATIO_NUM_STRING                  "RATIO_NUM"
+#define RATIO_DEN_STRING                  "RATIO_DEN"
+#define RATIO_NUM_WIDTH_STRING            "RATIO_NUM_WIDTH"
+#define RATIO_DEN_WIDTH_STRING            "RATIO_DEN_WIDTH"
+#define RATIO_VALUE_STRING                "RATIO_VALUE"
+#define RATIO_MEAN_STRING                 "RATIO_MEAN"
+#define RATIO_STD_STRING                  "RATIO_STD"
+#define AIR_RATIO_STRING                  "AIR_RATIO"
+#define AIR_LOW_STRING                    "AIR_LOW"
+#define AIR_HIGH_STRING                   "AIR_HIGH"
+#define AIR_LEAK_STRING                   "AIR_LEAK"
+#define WATER_RATIO_STRING                "WATER_RATIO"
+#define WATER_ON_STRING                   "WATER_ON"
+#define WATER_OFF_STRING                  "WATER_OFF"
+#define WATER_DOMINATED_STRING            "WATER_DOMINATED"
+//Partial vs total pressure consistency
+#define CONS_RATIO_STRING                 "CONS_RATIO"
+#define CONS_DRIFT_STRING                 "CONS_DRIFT"
+#define CONS_DRIFT_LIMIT_STRING           "CONS_DRIFT_LIMIT"
+#define CONS_ALARM_STRING                 "CONS_ALARM"
+#define CONS_TREND_STRING                 "CONS_TREND"
+#define CONS_RESET_STRING                 "CONS_RESET"
+//EM gain calibration
+#define EMCAL_START_STRING                "EMCAL_START"
+#define EMCAL_TARGET_STRING               "EMCAL_TARGET"
+#define EMCAL_TOLERANCE_STRING            "EMCAL_TOLERANCE"
+#define EMCAL_SCANS_STRING                "EMCAL_SCANS"
+#define EMCAL_PHASE_STRING                "EMCAL_PHASE"
+#define EMCAL_ITER_STRING                 "EMCAL_ITER"
+#define EMCAL_VOLTAGE_STRING              "EMCAL_VOLTAGE"
+#define EMCAL_GAIN_STRING                 "EMCAL_GAIN"
+#define EMCAL_FARADAY_STRING              "EMCAL_FARADAY"
+//Lifetime analytics
+#define LIFE_FILE_STRING                  "LIFE_FILE"
+#define LIFE_PERIOD_STRING                "LIFE_PERIOD"
+#define LIFE_FIL_LIMIT_STRING             "LIFE_FIL_LIMIT"
+#define LIFE_SAMPLES_STRING               "LIFE_SAMPLES"
+#define LIFE_FIL_RATE_STRING              "LIFE_FIL_RATE"
+#define LIFE_FIL_REMAIN_STRING            "LIFE_FIL_REMAIN"
+#define LIFE_EM_RATE_STRING               "LIFE_EM_RATE"
+#define LIFE_EM_REMAIN_STRING             "LIFE_EM_REMAIN"
+//Diagnostic trends
+#define TREND_PERIOD_STRING               "TREND_PERIOD"
+#define TREND_CHANNEL_STRING              "TREND_CHANNEL"
+#define TREND_BUCKET_STRING               "TREND_BUCKET"
+#define TREND_RESET_STRING                "TREND_RESET"
+#define TREND_POINTS_STRING               "TREND_POINTS"
+#define TREND_TIME_STRING                 "TREND_TIME"
+#define TREND_MIN_STRING                  "TREND_MIN"
+#define TREND_MAX_STRING                  "TREND_MAX"
+#define TREND_MEAN_STRING                 "TREND_MEAN"
+//Fault event log
+#define FAULT_LOG_STRING                  "FAULT_LOG"
+#define FAULT_ACTIVE_STRING               "FAULT_ACTIVE"
+#define FAULT_ACTIVE_COUNT_STRING         "FAULT_ACTIVE_COUNT"
+#define FAULT_EVENT_COUNT_STRING          "FAULT_EVENT_COUNT"
+//Spectrum streaming
+#define STREAM_ENDPOINT_STRING            "STREAM_ENDPOINT"
+#define STREAM_QUEUE_STRING               "STREAM_QUEUE"
+#define STREAM_LISTENING_STRING           "STREAM_LISTENING"
+#define STREAM_CLIENTS_STRING             "STREAM_CLIENTS"
+#define STREAM_FRAMES_STRING              "STREAM_FRAMES"
+#define STREAM_DROPS_STRING               "STREAM_DROPS"
+//Shared memory export
+#define SHM_ENABLE_STRING                 "SHM_ENABLE"
+#define SHM_NAME_STRING                   "SHM_NAME"
+#define SHM_WRITES_STRING                 "SHM_WRITES"
+//Published spectrum identity
+#define SCAN_NUMBER_STRING                "SCAN_NUMBER"
+#define SCAN_CHANNEL_STRING               "SCAN_CHANNEL"
+#define SCAN_GATE_STRING                  "SCAN_GATE"
+#define MASS_AXIS_VERSION_STRING          "MASS_AXIS_VERSION"
+//Control and bulk connections
+#define LANE_REQUESTS_STRING              "LANE_REQUESTS"
+#define LANE_ERRORS_STRING                "LANE_ERRORS"
+#define LANE_LATENCY_STRING               "LANE_LATENCY"
+#define LANE_LATENCY_MAX_STRING           "LANE_LATENCY_MAX"
+#define LANE_LATENCY_MEAN_STRING          "LANE_LATENCY_MEAN"
+#define LANE_KBYTES_STRING                "LANE_KBYTES"
+//Scan completion prediction
+#define SCAN_ALIGN_STRING                 "SCAN_ALIGN"
+#define SCAN_PERIOD_EST_STRING            "SCAN_PERIOD_EST"
+#define SCAN_PREDICT_ERROR_STRING         "SCAN_PREDICT_ERROR"
+#define SCAN_IDLE_POLLS_STRING            "SCAN_IDLE_POLLS"
+//Poll clock
+#define POLL_PERIOD_STRING                "POLL_PERIOD"
+#define POLL_CYCLE_STRING                 "POLL_CYCLE"
+#define POLL_CYCLE_MAX_STRING             "POLL_CYCLE_MAX"
+#define POLL_OVERRUNS_STRING              "POLL_OVERRUNS"
+#define POLL_SKIPPED_STRING               "POLL_SKIPPED"
+#define POLL_HIST_STRING                  "POLL_HIST"
+#define POLL_RESET_STRING                 "POLL_RESET"
+//Publish thread
+#define PUBLISH_SCANS_STRING              "PUBLISH_SCANS"
+#define PUBLISH_COALESCED_STRING          "PUBLISH_COALESCED"
+#define PUBLISH_TIME_STRING               "PUBLISH_TIME"
+#define PUBLISH_TIME_MAX_STRING           "PUBLISH_TIME_MAX"
 
 typedef struct {
     char ip[32];
@@ -210,20 +544,563 @@ typedef struct {
     double chStopMass;
     unsigned int chDwell;
     unsigned int chPpamu;
+    bool chEnabled;
 } chScanSetupStruct;
 
 typedef struct {
     unsigned int scanSize;
     unsigned int actualScanSize;
     unsigned int scanNumber;
+    double startMass;                       /* scan setup the mass axis was built from */
+    double stopMass;
+    unsigned int ppamu;
 	float scanValues[MAX_SCAN_SIZE];
 	float amuValues[MAX_SCAN_SIZE];
 } scanDataStruct;
 
+typedef struct {
+    double pollTime;                        /* pressure sampling period [s] */
+    double histWindow;                      /* length of published waveform [s] */
+    double statWindow;                      /* min/max/mean window [s] */
+    unsigned int head;                      /* next slot to be written */
+    unsigned int count;                     /* number of valid samples */
+    double sampleTime[PRESS_HIST_SIZE];     /* seconds past EPICS epoch */
+    float sampleValue[PRESS_HIST_SIZE];
+    float histValues[PRESS_HIST_SIZE];      /* chronological copy for callbacks */
+    float histTime[PRESS_HIST_SIZE];        /* seconds relative to the newest sample */
+} pressHistStruct;
+
+typedef enum {
+    CAPTURE_DISARMED = 0,
+    CAPTURE_ARMED = 1,
+    CAPTURE_TRIGGERED = 2
+} captureState_t;
+
+typedef enum {
+    CAPTURE_TRIG_EXTERNAL = 0,
+    CAPTURE_TRIG_PRESS_LEVEL = 1,
+    CAPTURE_TRIG_PRESS_RATE = 2
+} captureTrigger_t;
+
+typedef struct {
+    unsigned int scanNumber;
+    unsigned int scanSize;
+    int channel;
+    double massStart;                       /* mass axis of this scan */
+    double massStep;
+    double timeStamp;                       /* when the scan completed, seconds past EPICS epoch */
+    double totalPressure;
+    float scanValues[MAX_SCAN_SIZE];
+} captureScanStruct;
+
+typedef struct {
+    //Settings
+    bool armed;
+    unsigned int preScans;
+    unsigned int postScans;
+    double pressLevel;                      /* 0 disables the level trigger */
+    double pressRate;                       /* 0 disables the rate trigger [pressure/s] */
+    char directory[CAPTURE_PATH_SIZE];
+    //Rolling pre-trigger buffer, filled by the poller
+    captureScanStruct scans[CAPTURE_RING_SIZE];
+    unsigned int head;
+    unsigned int count;
+    //Trigger state
+    captureState_t state;
+    captureTrigger_t trigger;
+    double triggerTime;
+    unsigned int preTaken;
+    unsigned int postTaken;
+    double lastPressTime;
+    double lastPressValue;
+    //Frozen copy, owned by the writer thread while writerBusy is set
+    bool writerBusy;
+    captureScanStruct dump[CAPTURE_RING_SIZE];
+    unsigned int dumpCount;
+    unsigned int dumpPre;
+    captureTrigger_t dumpTrigger;
+    double dumpTriggerTime;
+    char dumpDirectory[CAPTURE_PATH_SIZE];
+    double dumpPressTime[PRESS_HIST_SIZE];
+    float dumpPressValue[PRESS_HIST_SIZE];
+    unsigned int dumpPressCount;
+    //Statistics
+    int captures;
+    int missed;
+    char lastFile[CAPTURE_PATH_SIZE];
+} captureStruct;
+
+typedef enum {
+    GATE_OFF = 0,                           /* every scan published, no tagging */
+    GATE_TAG = 1,                           /* every scan published and tagged */
+    GATE_KEEP = 2                           /* only scans overlapping a gate published */
+} gateMode_t;
+
+typedef struct {
+    gateMode_t mode;
+    int current;                            /* active gate, 0 = none */
+    //Gate transitions, written by writeInt32
+    double histTime[GATE_HIST_SIZE];        /* seconds past EPICS epoch */
+    int histGate[GATE_HIST_SIZE];
+    unsigned int head;
+    unsigned int count;
+    double lastScanTime;                    /* when the previous scan completed */
+    //Per-gate averages and the scan setup they were taken with, index 0 unused
+    unsigned int avgCount[MAX_GATES + 1];
+    unsigned int avgSize[MAX_GATES + 1];
+    double avgStartMass[MAX_GATES + 1];
+    double avgStopMass[MAX_GATES + 1];
+    unsigned int avgPpamu[MAX_GATES + 1];
+    double avgSum[MAX_GATES + 1][MAX_SCAN_SIZE];
+    unsigned int dirty;                     /* bit per gate with an average to publish */
+    unsigned int axisDirty;                 /* bit per gate with a new mass axis to publish */
+    float avgValues[MAX_SCAN_SIZE];         /* built by the publish thread */
+    float avgMass[MAX_SCAN_SIZE];
+} gateStruct;
+
+typedef struct {
+    char name[SEQ_NAME_SIZE];
+    unsigned int channel;
+    unsigned int scans;                     /* completed scans before moving on */
+} seqStepStruct;
+
+typedef struct {
+    //Recipe
+    bool loaded;
+    unsigned int cycles;                    /* 0 = repeat forever */
+    bool channelUsed[MAX_CHANNELS];
+    chScanSetupStruct channel[MAX_CHANNELS];
+    unsigned int numSteps;
+    seqStepStruct step[SEQ_MAX_STEPS];
+    //Run state
+    unsigned int currStep;
+    unsigned int prevStep;
+    unsigned int currCycle;
+    int stepFirstScan;                      /* first device scan of currStep, -1 = next completed */
+} seqStruct;
+
+typedef struct {
+    double threshold;                       /* level for the points above threshold count */
+    double sum;
+    double mean;
+    double max;
+    double maxMass;
+    double noise;                           /* robust sigma from median absolute point to point difference */
+    unsigned int above;
+    double dynRange;                        /* log10(max/noise) */
+    float diff[MAX_SCAN_SIZE];              /* scratch for the noise estimate */
+} scanStatsStruct;
+
+typedef struct {
+    unsigned int width;                     /* requested number of points, rounded down to even */
+    unsigned int size;                      /* points in the last decimated scan */
+    float scanValues[MAX_DECIM_SIZE];
+    float amuValues[MAX_DECIM_SIZE];
+} decimStruct;
+
+typedef struct {
+    double startMass;                       /* start == stop is the single point nearest that mass */
+    double stopMass;                        /* stop < start or stop 0 disables the ROI */
+    int divider;                            /* publish every n-th scan */
+    int counter;
+    unsigned int first;                     /* slice of the last published scan */
+    unsigned int size;
+} roiStruct;
+
+typedef enum {
+    UNITS_TORR = 0,
+    UNITS_MBAR = 1,
+    UNITS_PA = 2
+} convUnits_t;
+
+typedef struct {
+    convUnits_t units;
+    double rsf[CONV_MAX_MASS + 1];          /* relative to N2 */
+    unsigned int rsfCount;                  /* entries loaded from the table file */
+    bool scaleValid;                        /* scale[] matches the settings and mass axis below */
+    unsigned int scaleSize;
+    double scaleSens;
+    float scaleFirst;
+    float scaleLast;
+    float scale[MAX_SCAN_SIZE];
+    unsigned int size;                      /* points in the last converted scan, 0 if none */
+    float values[MAX_SCAN_SIZE];
+} convStruct;
+
+typedef struct {
+    bool enable;
+    unsigned int order;                     /* 1 linear, 2 quadratic */
+    double threshold;                       /* amu, refit when a reference peak is off by more */
+    double minSnr;                          /* reference peak height over the scan noise */
+    unsigned int numRefs;
+    double refMass[CAL_MAX_REFS];
+    double coef[3];                         /* mass = c0 + c1*m + c2*m^2, m nominal */
+    double residual;                        /* rms of the last fit */
+    unsigned int fits;
+} calStruct;
+
+typedef struct {
+    int divider;                            /* analyze every n-th scan, 0 is off */
+    int counter;
+    unsigned int numPeaks;
+    double minSnr;                          /* peak height over the scan noise */
+    unsigned int found;
+    unsigned int top[PEAK_MAX];             /* scan indices, largest first */
+    float mass[PEAK_MAX];
+    float fwhm[PEAK_MAX];
+    float asym[PEAK_MAX];                   /* right over left half width */
+    float resolution[PEAK_MAX];             /* mass/fwhm */
+    unsigned int head;
+    unsigned int count;
+    float trendFwhm[PEAK_TREND_SIZE];       /* mean over the peaks of each analysis */
+    float trendRes[PEAK_TREND_SIZE];
+    float histFwhm[PEAK_TREND_SIZE];        /* chronological copies for callbacks */
+    float histRes[PEAK_TREND_SIZE];
+} peakStruct;
+
+typedef struct {
+    bool enable;
+    double alpha;                           /* weight of a new scan in the reference */
+    double threshold;                       /* alarm level of the score */
+    unsigned int warmup;                    /* scans learned before alarms are raised */
+    unsigned int relearn;                   /* alarmed scans in a row before relearning, 0 never */
+    unsigned int count;                     /* scans in the reference, 0 restarts learning */
+    unsigned int alarmed;                   /* consecutive scans in alarm */
+    unsigned int size;                      /* scan setup the reference was learned on */
+    double startMass;
+    double stopMass;
+    unsigned int ppamu;
+    float mean[MAX_SCAN_SIZE];
+    float var[MAX_SCAN_SIZE];
+    float z[MAX_SCAN_SIZE];                 /* squared deviation of the last scan in sigmas */
+    float topMass[ANOM_TOP];
+    float topScore[ANOM_TOP];
+} anomStruct;
+
+typedef struct {
+    int numMass;
+    int denMass;
+    double numWidth;                        /* amu integrated on each side of the mass */
+    double denWidth;
+    double numSum;                          /* window integrals of the last scan */
+    double denSum;
+    unsigned int head;
+    unsigned int count;
+    float hist[RATIO_HIST_SIZE];
+} ratioEntryStruct;
+
+typedef struct {
+    double width;                           /* amu around each nominal mass that is integrated */
+    unsigned int window;                    /* ratios in the rolling statistics */
+    unsigned int airEntry;                  /* ratio entry the air leak indicator watches */
+    double airLow;                          /* its band for the air leak indicator */
+    double airHigh;
+    unsigned int waterEntry;                /* ratio entry the water indicator watches */
+    double waterOn;                         /* its levels for the water indicator */
+    double waterOff;
+    int airLeak;
+    int waterDominated;
+    unsigned int maxMass;                   /* highest mass bin with data */
+    float integral[CONV_MAX_MASS + 1];
+    float mass[CONV_MAX_MASS + 1];          /* nominal mass of each integral bin */
+    ratioEntryStruct entry[RATIO_MAX + 1];
+} ratioStruct;
+
+typedef struct {
+    double driftLimit;                      /* %/h, 0 disables the alarm */
+    double lastTime;                        /* newest pressure sample used so far */
+    unsigned int head;
+    unsigned int count;
+    double time[CONS_HIST_SIZE];            /* seconds past EPICS epoch */
+    float ratio[CONS_HIST_SIZE];            /* summed partial over total pressure */
+    float histRatio[CONS_HIST_SIZE];        /* chronological copy for callbacks */
+} consStruct;
+
+typedef enum {
+    EMCAL_IDLE = 0,
+    EMCAL_FARADAY = 1,                      /* EM off, reference reading */
+    EMCAL_SEARCH = 2,                       /* EM on, stepping the voltage */
+    EMCAL_DONE = 3,
+    EMCAL_FAILED = 4,
+    EMCAL_ABORTED = 5
+} emCalPhase_t;
+
+typedef struct {
+    double target;                          /* gain at the EM gain mass */
+    double tolerance;                       /* % */
+    unsigned int scans;                     /* readings averaged per step */
+    emCalPhase_t phase;
+    unsigned int mass;
+    unsigned int vMin;
+    unsigned int vMax;
+    unsigned int voltage;                   /* voltage being measured */
+    unsigned int savedVoltage;              /* device state before the calibration */
+    unsigned int savedEmOn;
+    chScanSetupStruct savedSetup;           /* channel 4 */
+    unsigned int savedStartChannel;
+    unsigned int savedStopChannel;
+    int settleScan;                         /* readings from later scans only */
+    double sum;
+    unsigned int readings;
+    double faraday;
+    double gain;
+    unsigned int iteration;
+    bool haveLow, haveHigh, havePrev;       /* ln(gain/target) below/above zero, secant point */
+    unsigned int vLow, vHigh, vPrev;
+    double errLow, errHigh, errPrev;
+    double gainLow, gainHigh;               /* gain read at each end of the bracket */
+} emCalStruct;
+
+/* The store is a ring of LIFE_SIZE record slots after the header, slot i holds record[i] */
+typedef struct {
+    char magic[4];
+    epicsUInt32 version;
+    epicsUInt32 recordSize;
+    epicsUInt32 capacity;                   /* record slots, LIFE_SIZE */
+    epicsUInt32 head;                       /* slot the next record goes to */
+    epicsUInt32 count;                      /* slots in use */
+} lifeFileHeaderStruct;
+
+/* One record per LIFE_PERIOD, written to the store as is */
+typedef struct {
+    epicsUInt32 time;                       /* seconds past EPICS epoch */
+    epicsUInt32 filSel;
+    float emHours;
+    float filHours[2];
+    epicsUInt32 emPressTrip;
+    epicsUInt32 filPressTrip[2];
+    epicsUInt32 emV;
+    float emGain;
+    float emiCurrent;                       /* averages over the period, emission on */
+    float filCurrent;
+    float boxTemp;
+} lifeRecordStruct;
+
+typedef struct {
+    char fileName[CAPTURE_PATH_SIZE];       /* empty keeps the records in memory only */
+    epicsUInt32 period;                     /* seconds between records */
+    double filCurrentLimit;                 /* filament current at end of life */
+    epicsUInt32 periodStart;
+    double sumEmi;
+    double sumFil;
+    double sumTemp;
+    unsigned int samples;
+    unsigned int head;
+    unsigned int count;
+    lifeRecordStruct record[LIFE_SIZE];
+    double x[LIFE_SIZE];                    /* scratch for the fits */
+    double y[LIFE_SIZE];
+} lifeStruct;
+
+typedef enum {
+    TREND_BOX_TEMP = 0,
+    TREND_ANODE_POT,
+    TREND_FOCUS_POT,
+    TREND_FIL_POT,
+    TREND_ELECT_ENERGY,
+    TREND_EMI_CURRENT,
+    TREND_FIL_CURRENT,
+    TREND_EM_POT
+} trendChannel_t;
+
+typedef struct {
+    double bucket;                          /* seconds per point, 0 keeps every sample */
+    double bucketStart;                     /* time of the open bucket */
+    unsigned int accCount;                  /* samples in the open bucket */
+    float accMin[TREND_CHANNELS];
+    float accMax[TREND_CHANNELS];
+    double accSum[TREND_CHANNELS];
+    unsigned int head;
+    unsigned int count;
+    bool dirty;                             /* new points since the last publish */
+    double time[TREND_SIZE];                /* bucket start, seconds past EPICS epoch */
+    float min[TREND_CHANNELS][TREND_SIZE];
+    float max[TREND_CHANNELS][TREND_SIZE];
+    float mean[TREND_CHANNELS][TREND_SIZE];
+} trendScaleStruct;
+
+typedef struct {
+    double period;                          /* diagnostic sampling period [s] */
+    unsigned int channel;                   /* trendChannel_t published */
+    trendScaleStruct scale[TREND_SCALES+1];
+    float outTime[TREND_SIZE];              /* chronological copies for callbacks */
+    float outMin[TREND_SIZE];
+    float outMax[TREND_SIZE];
+    float outMean[TREND_SIZE];
+} trendStruct;
+
+typedef struct {
+    epicsTimeStamp time;
+    bool warning;                           /* hardwareWarnings, else hardwareErrors */
+    unsigned int bit;
+    bool set;                               /* raised, else cleared */
+} faultEventStruct;
+
+typedef struct {
+    bool valid;                             /* hwError/hwWarn hold a device read */
+    unsigned int hwError;
+    unsigned int hwWarn;
+    unsigned int head;
+    unsigned int count;
+    int total;                              /* transitions since start */
+    faultEventStruct event[FAULT_LOG_SIZE];
+    char activeText[FAULT_ACTIVE_SIZE];
+    char logText[FAULT_TEXT_SIZE];
+    char errorLog[FAULT_TEXT_SIZE];         /* device error log, read on change */
+} faultStruct;
+
+/* Frame header on the stream, native byte order, followed by points float32 values and
+ * points float32 masses. The mass axis need not be linear after a mass calibration. */
+typedef struct {
+    epicsUInt32 magic;                      /* STREAM_MAGIC */
+    epicsUInt16 version;
+    epicsUInt16 headerSize;                 /* bytes up to the payload */
+    epicsUInt32 scanNumber;
+    epicsUInt32 points;
+    epicsUInt32 secPastEpoch;               /* EPICS epoch */
+    epicsUInt32 nsec;
+    float firstMass;                        /* first mass and mean spacing, exact masses follow */
+    float massStep;
+    epicsUInt16 channel;                    /* scan setup channel */
+    epicsUInt16 gate;                       /* gate tag, 0 if none */
+    epicsUInt32 dropped;                    /* frames this client missed before this one */
+} streamHeaderStruct;
+
+typedef struct {
+    streamHeaderStruct header;
+    unsigned int refs;                      /* client queues holding the frame */
+    float values[2*MAX_SCAN_SIZE];          /* points values, then points masses */
+} streamFrameStruct;
+
+typedef struct {
+    int fd;                                 /* -1 for a free slot */
+    unsigned int queue[STREAM_MAX_QUEUE];   /* pool indices */
+    unsigned int head;
+    unsigned int count;
+    size_t sent;                            /* bytes of the head frame already written */
+    streamHeaderStruct header;              /* header of the head frame as sent to this client */
+    epicsUInt32 drops;                      /* frames missed since the last delivered one */
+} streamClientStruct;
+
+typedef struct {
+    char endpoint[CAPTURE_PATH_SIZE];       /* empty disables the server */
+    bool reconfigure;
+    unsigned int depth;                     /* queue length per client */
+    int listenFd;
+    int wakeFd[2];                          /* self-pipe waking the stream thread */
+    char unixPath[CAPTURE_PATH_SIZE];       /* socket file to remove on close */
+    int clients;
+    epicsUInt32 frames;
+    epicsUInt32 drops;
+    streamClientStruct client[STREAM_MAX_CLIENTS];
+    streamFrameStruct *pool;
+} streamStruct;
+
+typedef struct {
+    unsigned int scanSize;                  /* axis of the last published spectrum */
+    float firstMass;
+    float lastMass;
+    unsigned int calFits;
+    int axisVersion;
+} scanMetaStruct;
+
+/* HTTP connections to the device, also the asyn addresses of their statistics */
+typedef enum {
+    LANE_CONTROL = 1,                       /* status, total pressure and writes */
+    LANE_BULK = 2,                          /* spectra */
+    LANE_PRESSURE = 3                       /* total pressure samples */
+} httpLane_t;
+
+typedef struct {
+    unsigned int requests;
+    unsigned int errors;
+    double lastLatency;                     /* ms */
+    double maxLatency;
+    double sumLatency;
+    double bytes;                           /* received */
+} laneStatsStruct;
+
+typedef struct {
+    bool busy;                              /* a spectrum read is outstanding */
+    bool discard;                           /* drop it, monitoring was restarted */
+    unsigned int channel;                   /* scan setup channel of the requested scan */
+    epicsTimeStamp scanEnd;                 /* when the requested scan completed, best estimate */
+    double scanPeriod;                      /* its duration, 0 if not known yet */
+    char *data;                             /* response buffer of the bulk connection */
+} bulkStruct;
+
+typedef struct {
+    bool enable;                            /* wake at the predicted scan end, else every pollTime_ */
+    int channel;                            /* scan setup channel the estimate belongs to */
+    unsigned int points;                    /* points per scan */
+    double period;                          /* estimated scan duration [s], 0 if unknown */
+    int lastScan;                           /* last completed scan seen */
+    bool timed;                             /* lastDone is when lastScan was seen to complete */
+    epicsTimeStamp lastDone;
+    bool predicted;                         /* nextDone is valid */
+    epicsTimeStamp nextDone;                /* predicted end of the running scan */
+    epicsTimeStamp lastPoll;                /* previous scan info read, 0 before the first */
+    epicsTimeStamp doneEstimate;            /* when lastScan completed, between lastPoll and lastDone */
+    double error;                           /* completion seen minus predicted [ms] */
+    unsigned int idlePolls;                 /* polls while scanning that found no new scan */
+} scanPredictStruct;
+
+typedef struct {
+    bool restart;                           /* start a new tick grid at the end of the next cycle */
+    epicsTimeStamp nextTick;                /* deadline of the next cycle */
+    double lastCycle;                       /* duration of the last cycle [ms] */
+    double maxCycle;
+    unsigned int overruns;                  /* cycles longer than the period */
+    unsigned int skipped;                   /* ticks that came due while a cycle was running */
+    unsigned int hist[POLL_HIST_BINS];
+    float histValues[POLL_HIST_BINS];       /* copy for callbacks */
+} pollClockStruct;
+
+/* A completed scan as the publish thread sends it out */
+typedef struct {
+    scanDataStruct scan;
+    unsigned int channel;
+    int gate;
+    bool valid;                             /* parsed without error, publish the scan metadata */
+    unsigned int generation;                /* monitor run the scan belongs to */
+    unsigned int decimSize;
+    float decimScan[MAX_DECIM_SIZE];
+    float decimAmu[MAX_DECIM_SIZE];
+    unsigned int convSize;
+    float conv[MAX_SCAN_SIZE];
+} publishSnapStruct;
+
+/* An array kept in driver state, sent from the publish thread with the port locked */
+typedef struct {
+    float *values;
+    size_t size;
+    int reason;
+    int addr;
+} publishArrayStruct;
+
+typedef struct {
+    bool params;                            /* parameter callbacks requested, port lock */
+    bool trends;                            /* trend scales to publish, port lock */
+    unsigned int numArrays;                 /* port lock */
+    publishArrayStruct array[PUBLISH_MAX_ARRAYS];
+    bool clear;                             /* blank the scan arrays, publishLock_ */
+    unsigned int generation;                /* bumped on every monitor restart, publishLock_ */
+    bool scanPending;                       /* pending not yet taken, publishLock_ */
+    publishSnapStruct pending;              /* newest completed scan, publishLock_ */
+    publishSnapStruct out;                  /* being published, owned by the publish thread */
+    float zeros[MAX_SCAN_SIZE];             /* blank arrays for a restart */
+    unsigned int scans;                     /* scans published */
+    unsigned int coalesced;                 /* scans replaced by a newer one before publishing */
+    double lastTime;                        /* duration of the last publish [ms] */
+    double maxTime;
+} publishStruct;
+
 typedef enum {
     IDLE = 0,
     MONITORING = 1,
-	LEAKCEHCK = 2
+	LEAKCEHCK = 2,
+    SEQUENCE = 3,
+    EMCAL = 4
 } mainState_t;
 
 class drvInficon : public asynPortDriver {
@@ -264,10 +1141,29 @@ public:
     virtual asynStatus writeOctet(asynUser *pasynUser, const char *value, size_t maxChars, size_t *nActual);
     virtual asynStatus readOctet(asynUser *pasynUser, char *value, size_t maxChars, size_t *nActual, int *eomReason);
 
+    /* Parameter setters, they also record which addresses need callbacks */
+    using asynPortDriver::setIntegerParam;
+    using asynPortDriver::setDoubleParam;
+    using asynPortDriver::setStringParam;
+    using asynPortDriver::setUIntDigitalParam;
+    virtual asynStatus setIntegerParam(int list, int index, int value);
+    virtual asynStatus setDoubleParam(int list, int index, double value);
+    virtual asynStatus setStringParam(int list, int index, const char *value);
+    virtual asynStatus setUIntDigitalParam(int list, int index, epicsUInt32 value, epicsUInt32 valueMask,
+                                           epicsUInt32 interruptMask);
+
+    /* Driver settings, their values are reported back to the output records on init */
+    asynStatus createSetting(const char *name, asynParamType type, int *index);
+    bool isSetting(int index) const;
+
     /* These are the methods that are new to this class */
     void pollerThread();
-    asynStatus inficonReadWrite(const char *request, char *response);
-    asynStatus parseScan(const char *jsonData, scanDataStruct *scanData);
+    void pressureThread();
+    void captureThread();
+    void streamThread();
+    void bulkThread();
+    asynStatus inficonReadWrite(const char *request, char *response, httpLane_t lane = LANE_CONTROL);
+    asynStatus parseScan(const char *jsonData, scanDataStruct *scanData, unsigned int chNumber);
     asynStatus parseCommParam(const char *jsonData, commParamStruct *commParam);
     asynStatus parseSensInfo(const char *jsonData, sensInfoStruct *sensInfo);
     asynStatus parseDevStatus(const char *jsonData, devStatusStruct *devStatus);
@@ -276,9 +1172,68 @@ public:
     asynStatus parseSensDetect(const char *jsonData, sensDetectStruct *sensDetect);
     asynStatus parseSensFilt(const char *jsonData, sensFiltStruct *sensFilt);
     asynStatus parseChScanSetup(const char *jsonData, chScanSetupStruct *chScanSetup, unsigned int chNumber);
+    asynStatus parseScanChannels(const char *jsonData, unsigned int *startChannel, unsigned int *stopChannel);
+    asynStatus parseEmState(const char *jsonData, unsigned int *emOn);
     asynStatus parsePressure(const char *jsonData, double *value);
     asynStatus parseSensIonSource(const char *jsonData, sensIonSourceStruct *sensIonSource);
     asynStatus parseLeakChk(const char *jsonData, double *value);
+    void pushPressure(const epicsTimeStamp *sampleTime, double value);
+    void publishPressHist();
+    void captureScan(const scanDataStruct *scanData, int channel, const epicsTimeStamp *scanEnd);
+    void checkCaptureTrigger(const epicsTimeStamp *sampleTime, double value);
+    void triggerCapture(captureTrigger_t trigger);
+    void freezeCapture();
+    asynStatus writeCapture(char *fileName);
+    int gateScan(const scanDataStruct *scanData, const epicsTimeStamp *scanEnd, double period);
+    void resetGates();
+    asynStatus loadSequence(const char *fileName);
+    asynStatus startSequence();
+    void advanceSequence();
+    void processScan(scanDataStruct *scanData);
+    void computeScanStats(const scanDataStruct *scanData);
+    void decimateScan(const scanDataStruct *scanData);
+    void publishRois(const scanDataStruct *scanData);
+    asynStatus loadRsfTable(const char *fileName);
+    void convertScan(const scanDataStruct *scanData);
+    void calibrateMass(scanDataStruct *scanData);
+    void resetMassCal();
+    void analyzePeaks(const scanDataStruct *scanData);
+    void detectAnomaly(const scanDataStruct *scanData);
+    void integrateMasses(const scanDataStruct *scanData);
+    void computeRatios();
+    void checkConsistency(const scanDataStruct *scanData);
+    asynStatus startEmCal();
+    void setEmCalVoltage(unsigned int voltage);
+    void emCalReading(int scanNumber, double value);
+    void finishEmCal(emCalPhase_t result);
+    asynStatus openLifeStore(const char *fileName);
+    void lifeAccumulate();
+    void estimateLife();
+    void resetTrend(unsigned int scale);
+    void pushTrend(const epicsTimeStamp *sampleTime);
+    void publishTrends(bool all);
+    bool decodeFaults(unsigned int hwError, unsigned int hwWarn);
+    void publishFaultLog();
+    asynStatus parseErrorLog(const char *jsonData, char *errorLog, size_t maxChars);
+    void openStreamServer();
+    void closeStreamServer();
+    void closeStreamClient(streamClientStruct *client);
+    bool sendStreamClient(streamClientStruct *client);
+    void streamScan(const scanDataStruct *scanData, int channel, int gate);
+    asynStatus openShm();
+    void closeShm();
+    void shmScan(const scanDataStruct *scanData, int channel, int gate);
+    void publishScanMeta(const scanDataStruct *scanData, int channel, int gate);
+    void publishLaneStats();
+    void predictScan(unsigned int channel);
+    double scanWaitTime(bool scanning, double tickWait, const epicsTimeStamp *trendDue);
+    double pollClockTick(const epicsTimeStamp *cycleStart);
+    void publishPollClock();
+    void publishThread();
+    void queueScan(const scanDataStruct *scanData, unsigned int channel, int gate, bool valid);
+    void queueArray(float *values, size_t size, int reason, int addr);
+    void requestPublish();
+    void publishGates();
     asynStatus verifyConnection();   // Verify connection using asynUser //Return asynSuccess for connect
     bool inficonExiting_;
 
@@ -288,7 +1243,7 @@ protected:
     int getCommParam_;
     int ip_;
     int mac_;
-    //int errorLog_;
+    int errorLog_;
     //General control parameters
     int emiOn_;
     int emOn_;
@@ -375,6 +1330,211 @@ protected:
     int driverState_;
     int startMonitor_;
     int startLeakcheck_;
+    //Total pressure history
+    int pressPollTime_;
+    int pressHistWindow_;
+    int pressStatWindow_;
+    int pressHist_;
+    int pressHistTime_;
+    int pressMin_;
+    int pressMax_;
+    int pressMean_;
+    //Event capture
+    int captureArm_;
+    int captureTrig_;
+    int capturePre_;
+    int capturePost_;
+    int capturePressLevel_;
+    int capturePressRate_;
+    int captureDir_;
+    int captureState_;
+    int captureBusy_;
+    int captureCount_;
+    int captureMissed_;
+    int captureFile_;
+    //Gated acquisition
+    int gate_;
+    int gateMode_;
+    int gateReset_;
+    int gateTag_;
+    int gateCount_;
+    int gateAvg_;
+    int gateXCoord_;
+    //Sequence engine
+    int seqFile_;
+    int seqStart_;
+    int seqSteps_;
+    int seqStep_;
+    int seqStepName_;
+    int seqCycle_;
+    int scanStep_;
+    int scanStepName_;
+    //Spectrum statistics
+    int statsThreshold_;
+    int statsSum_;
+    int statsMean_;
+    int statsMax_;
+    int statsMaxMass_;
+    int statsNoise_;
+    int statsAbove_;
+    int statsDynRange_;
+    //Spectrum decimation
+    int decimWidth_;
+    int decimScan_;
+    int decimXCoord_;
+    //Regions of interest
+    int roiStart_;
+    int roiStop_;
+    int roiDivider_;
+    int roiPoints_;
+    int roiScan_;
+    int roiXCoord_;
+    //Unit conversion
+    int convUnits_;
+    int convEgu_;
+    int convRsfFile_;
+    int convRsfCount_;
+    int convScan_;
+    //Mass axis calibration
+    int calEnable_;
+    int calOrder_;
+    int calThreshold_;
+    int calMinSnr_;
+    int calC0_;
+    int calC1_;
+    int calC2_;
+    int calResidual_;
+    int calDrift_;
+    int calPeaks_;
+    int calFits_;
+    //Peak shape analysis
+    int peakDivider_;
+    int peakNum_;
+    int peakMinSnr_;
+    int peakFound_;
+    int peakMass_;
+    int peakFwhm_;
+    int peakAsym_;
+    int peakRes_;
+    int peakFwhmMean_;
+    int peakResMean_;
+    int peakTrendFwhm_;
+    int peakTrendRes_;
+    //Anomaly detection
+    int anomEnable_;
+    int anomReset_;
+    int anomAlpha_;
+    int anomThreshold_;
+    int anomWarmup_;
+    int anomRelearn_;
+    int anomScore_;
+    int anomAlarm_;
+    int anomCount_;
+    int anomTopMass_;
+    int anomTopScore_;
+    int anomRef_;
+    //Mass ratios
+    int massIntegral_;
+    int massIntegralMass_;
+    int ratioWidth_;
+    int ratioWindow_;
+    int ratioNum_;
+    int ratioDen_;
+    int ratioNumWidth_;
+    int ratioDenWidth_;
+    int ratioValue_;
+    int ratioMean_;
+    int ratioStd_;
+    int airRatio_;
+    int airLow_;
+    int airHigh_;
+    int airLeak_;
+    int waterRatio_;
+    int waterOn_;
+    int waterOff_;
+    int waterDominated_;
+    //Partial vs total pressure consistency
+    int consRatio_;
+    int consDrift_;
+    int consDriftLimit_;
+    int consAlarm_;
+    int consTrend_;
+    int consReset_;
+    //EM gain calibration
+    int emCalStart_;
+    int emCalTarget_;
+    int emCalTolerance_;
+    int emCalScans_;
+    int emCalPhase_;
+    int emCalIter_;
+    int emCalVoltage_;
+    int emCalGain_;
+    int emCalFaraday_;
+    //Lifetime analytics
+    int lifeFile_;
+    int lifePeriod_;
+    int lifeFilLimit_;
+    int lifeSamples_;
+    int lifeFilRate_;
+    int lifeFilRemain_;
+    int lifeEmRate_;
+    int lifeEmRemain_;
+    //Diagnostic trends
+    int trendPeriod_;
+    int trendChannel_;
+    int trendBucket_;
+    int trendReset_;
+    int trendPoints_;
+    int trendTime_;
+    int trendMin_;
+    int trendMax_;
+    int trendMean_;
+    //Fault event log
+    int faultLog_;
+    int faultActive_;
+    int faultActiveCount_;
+    int faultEventCount_;
+    //Spectrum streaming
+    int streamEndpoint_;
+    int streamQueue_;
+    int streamListening_;
+    int streamClients_;
+    int streamFrames_;
+    int streamDrops_;
+    //Shared memory export
+    int shmEnable_;
+    int shmName_;
+    int shmWrites_;
+    //Published spectrum identity
+    int scanNumber_;
+    int scanChannel_;
+    int scanGate_;
+    int massAxisVersion_;
+    //Control and bulk connections
+    int laneRequests_;
+    int laneErrors_;
+    int laneLatency_;
+    int laneLatencyMax_;
+    int laneLatencyMean_;
+    int laneKBytes_;
+    //Scan completion prediction
+    int scanAlign_;
+    int scanPeriodEst_;
+    int scanPredictError_;
+    int scanIdlePolls_;
+    //Poll clock
+    int pollPeriod_;
+    int pollCycle_;
+    int pollCycleMax_;
+    int pollOverruns_;
+    int pollSkipped_;
+    int pollHist_;
+    int pollReset_;
+    //Publish thread
+    int publishScans_;
+    int publishCoalesced_;
+    int publishTime_;
+    int publishTimeMax_;
 
 private:
     /* Our data */
@@ -382,11 +1542,16 @@ private:
     bool isConnected_;           /* Connection status */
     char *portName_;             /* asyn port name for the user driver */
     char *octetPortName_;        /* asyn port name for the asyn octet port */
+    char *bulkPortName_;         /* asyn port name for the spectrum connection */
+    char *pressPortName_;        /* asyn port name for the total pressure connection */
     char *hostInfo_;             /* host info (IP address,connection type, port)*/
     asynUser  *pasynUserOctet_;  /* asynUser for asynOctet interface to asyn octet port */
+    asynUser  *pasynUserBulk_;   /* asynUser for asynOctet interface to the spectrum port */
+    asynUser  *pasynUserPress_;  /* asynUser for asynOctet interface to the total pressure port */
     asynUser  *pasynUserCommon_; /* asynUser for asynCommon interface to asyn octet port */
     asynUser  *pasynUserTrace_;  /* asynUser for asynTrace on this port */
     char *data_;                 /* Memory buffer */
+    char *pressData_;            /* response buffer of the pressure thread */
     asynStatus ioStatus_;
     asynStatus prevIOStatus_;
     commParamStruct *commParams_;
@@ -401,10 +1566,50 @@ private:
     scanDataStruct *scanData_;
     sensIonSourceStruct *sensIonSource_;
     double totalPressure_;
+    pressHistStruct *pressHistory_;
+    captureStruct *capture_;
+    gateStruct *gates_;
+    seqStruct *sequence_;
+    scanStatsStruct *scanStats_;
+    decimStruct *decim_;
+    roiStruct rois_[MAX_ROIS + 1];
+    convStruct *conv_;
+    calStruct *cal_;
+    peakStruct *peaks_;
+    anomStruct *anomaly_;
+    ratioStruct *ratios_;
+    consStruct *consistency_;
+    emCalStruct *emCal_;
+    lifeStruct *life_;
+    trendStruct *trend_;
+    faultStruct *faults_;
+    streamStruct *stream_;
+    inficonShmLayout *shm_;                 /* mapped ring, NULL when disabled */
+    char shmPath_[INFICON_SHM_NAME_SIZE + 16];
+    scanMetaStruct *scanMeta_;
+    laneStatsStruct laneStats_[LANE_PRESSURE + 1];   /* laneLock_, updated outside the port lock */
+    epicsMutexId laneLock_;
+    bulkStruct *bulk_;
+    scanPredictStruct *scanPredict_;
+    pollClockStruct *pollClock_;
+    publishStruct *publish_;
     double pollTime_;
     bool forceCallback_;
+    unsigned int dirtyAddr_;                /* bit per address set since its last callbacks */
+    std::vector<bool> settings_;            /* by parameter index, see createSetting */
     epicsThreadId pollerThreadId_;
     epicsEventId pollerEventId_;
+    epicsThreadId pressureThreadId_;
+    epicsEventId pressureEventId_;
+    epicsThreadId captureThreadId_;
+    epicsEventId captureEventId_;
+    epicsThreadId streamThreadId_;
+    epicsMutexId streamLock_;
+    epicsThreadId bulkThreadId_;
+    epicsThreadId publishThreadId_;
+    epicsEventId publishEventId_;
+    epicsMutexId publishLock_;
+    epicsEventId bulkEventId_;
     mainState_t mainState_;
     bool startingLeakcheck_;
     bool startingMonitor_;
@@ -0,0 +1,64 @@
+//======================================================//
+// Name: inficonShm.h
+// Purpose: Layout of the shared memory spectrum ring exported by drvInficon
+//
+// The driver creates one POSIX shared memory object per asyn port,
+// named "/inficon_<port>". It holds a ring of the most recent spectra.
+// Every slot is protected by a sequence counter, odd while the driver
+// writes it. A reader takes the counter, reads the slot in place and
+// accepts the data only if the counter is unchanged and even.
+// Readers never block the driver.
+//======================================================//
+#ifndef inficonShm_H
+#define inficonShm_H
+
+#include <stdint.h>
+
+#define INFICON_SHM_MAGIC 0x4D484649u       /* "IFHM" little endian */
+#define INFICON_SHM_VERSION 1
+#define INFICON_SHM_SLOTS 16
+#define INFICON_SHM_MAX_POINTS 16384
+#define INFICON_SHM_NAME_SIZE 64
+
+typedef struct {
+    uint32_t seq;                           /* odd while the slot is being written */
+    uint32_t scanNumber;
+    uint32_t points;                        /* valid entries in values and masses */
+    uint32_t secPastEpoch;                  /* EPICS epoch, 1990-01-01 */
+    uint32_t nsec;
+    uint16_t channel;                       /* scan setup channel */
+    uint16_t gate;                          /* gate tag, 0 if none */
+    float values[INFICON_SHM_MAX_POINTS];
+    float masses[INFICON_SHM_MAX_POINTS];
+} inficonShmSlot;
+
+typedef struct {
+    uint32_t magic;                         /* INFICON_SHM_MAGIC once initialized */
+    uint32_t version;
+    uint32_t slotSize;                      /* sizeof(inficonShmSlot) */
+    uint32_t slots;                         /* INFICON_SHM_SLOTS */
+    uint64_t writeCount;                    /* spectra written, the newest is slot (writeCount-1) % slots */
+    char portName[INFICON_SHM_NAME_SIZE];
+    inficonShmSlot slot[INFICON_SHM_SLOTS];
+} inficonShmLayout;
+
+/* Start reading a slot, returns the counter to pass to inficonShmReadEnd */
+static inline uint32_t inficonShmReadBegin(const inficonShmSlot *slot)
+{
+    return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+}
+
+/* Nonzero if what was read since inficonShmReadBegin is consistent */
+static inline int inficonShmReadEnd(const inficonShmSlot *slot, uint32_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (seq & 1) == 0 && __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq;
+}
+
+/* Number of spectra written so far, 0 before the first one */
+static inline uint64_t inficonShmWriteCount(const inficonShmLayout *shm)
+{
+    return __atomic_load_n(&shm->writeCount, __ATOMIC_ACQUIRE);
+}
+
+#endif
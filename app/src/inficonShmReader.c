@@ -0,0 +1,85 @@
+//======================================================//
+// Name: inficonShmReader.c
+// Purpose: Example reader of the drvInficon shared memory spectrum ring
+//
+// Usage: inficonShmReader <asyn port name>
+// Prints one line per new spectrum: scan number, points and the
+// largest peak. The slot is read in place and the result is used only
+// if the sequence check passes, so a spectrum overwritten while it was
+// read is skipped, never torn.
+//======================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "inficonShm.h"
+
+int main(int argc, char *argv[])
+{
+    char name[INFICON_SHM_NAME_SIZE + 16];
+    const inficonShmLayout *shm;
+    const inficonShmSlot *slot;
+    uint64_t seen = 0, written;
+    uint32_t seq, scanNumber, points, peak;
+    float peakValue, peakMass;
+    int fd;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <asyn port name>\n", argv[0]);
+        return 1;
+    }
+    snprintf(name, sizeof(name), "/inficon_%s", argv[1]);
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        perror(name);
+        return 1;
+    }
+    shm = (const inficonShmLayout *)mmap(NULL, sizeof(inficonShmLayout), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    if (shm->magic != INFICON_SHM_MAGIC || shm->version != INFICON_SHM_VERSION ||
+        shm->slotSize != sizeof(inficonShmSlot)) {
+        fprintf(stderr, "%s: layout doesn't match this reader\n", name);
+        return 1;
+    }
+
+    while (1) {
+        written = inficonShmWriteCount(shm);
+        if (written == seen) {
+            usleep(1000);
+            continue;
+        }
+        //fell behind by more than the ring holds, continue with the oldest still there
+        if (written - seen > shm->slots)
+            seen = written - shm->slots;
+
+        slot = &shm->slot[seen % shm->slots];
+        seq = inficonShmReadBegin(slot);
+        scanNumber = slot->scanNumber;
+        points = slot->points;
+        if (points > INFICON_SHM_MAX_POINTS)
+            points = 0;
+        peak = 0;
+        peakValue = 0;
+        for (uint32_t i = 0; i < points; i++) {
+            if (slot->values[i] > peakValue) {
+                peakValue = slot->values[i];
+                peak = i;
+            }
+        }
+        peakMass = slot->masses[peak];
+        if (inficonShmReadEnd(slot, seq) && points > 0)
+            printf("scan %u: %u points, max %g at mass %.2f\n",
+                   scanNumber, points, peakValue, peakMass);
+        seen++;
+    }
+    return 0;
+}